@@ -10,6 +10,7 @@
 #else
 #include <inttypes.h>
 #endif
+#include <stddef.h>
 
 #define pass() (*get_test_reporter()->assert_true)(get_test_reporter(), __FILE__, __LINE__, true, NULL)
 #define fail(...)(*get_test_reporter()->assert_true)(get_test_reporter(), __FILE__, __LINE__, false, __VA_ARGS__)
@@ -22,6 +23,9 @@
 #define assert_double_not_equal(tried, expected) assert_double_not_equal_(__FILE__, __LINE__, tried, expected)
 #define assert_string_equal(tried, expected) assert_string_equal_(__FILE__, __LINE__, tried, expected)
 #define assert_string_not_equal(tried, expected) assert_string_not_equal_(__FILE__, __LINE__, tried, expected)
+#define assert_memory_equal(tried, expected, size) assert_memory_equal_(__FILE__, __LINE__, tried, expected, size)
+#define assert_int_array_equal(tried, expected, count) assert_int_array_equal_(__FILE__, __LINE__, tried, expected, count)
+#define assert_double_array_equal(tried, expected, count) assert_double_array_equal_(__FILE__, __LINE__, tried, expected, count)
 
 #define assert_true_with_message(result, ...) (*get_test_reporter()->assert_true)(get_test_reporter(), __FILE__, __LINE__, result, __VA_ARGS__)
 #define assert_false_with_message(result, ...) (*get_test_reporter()->assert_true)(get_test_reporter(), __FILE__, __LINE__, ! result, __VA_ARGS__)
@@ -38,7 +42,11 @@ void assert_double_equal_(const char *file, int line, double tried, double expec
 void assert_double_not_equal_(const char *file, int line, double tried, double expected);
 void assert_string_equal_(const char *file, int line, const char *tried, const char *expected);
 void assert_string_not_equal_(const char *file, int line, const char *tried, const char *expected);
+void assert_memory_equal_(const char *file, int line, const void *tried, const void *expected, size_t size);
+void assert_int_array_equal_(const char *file, int line, const int *tried, const int *expected, size_t count);
+void assert_double_array_equal_(const char *file, int line, const double *tried, const double *expected, size_t count);
 void significant_figures_for_assert_double_are(int figures);
+void units_in_last_place_for_assert_double_are(int units);
 const char *show_null_as_the_string_null(const char *string);
 int strings_are_equal(const char *tried, const char *expected);
 int doubles_are_equal(const double tried, const double expected);
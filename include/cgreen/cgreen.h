@@ -2,5 +2,8 @@
 #include <cgreen/text_reporter.h>
 #include <cgreen/cute_reporter.h>
 #include <cgreen/cdash_reporter.h>
+#include <cgreen/junit_reporter.h>
+#include <cgreen/event_log_reporter.h>
+#include <cgreen/multiplexing_reporter.h>
 #include <cgreen/assertions.h>
 #include <stdlib.h>
@@ -33,6 +33,8 @@ typedef enum {
 	CG_CONSTRAINT_FILL,
 } CgreenConstraintType;
 
+/* Doubles are passed in an intptr_t, as its bits where it is wide
+   enough, and otherwise in a box in the test memory */
 typedef union {
     double d;
 } BoxedDouble;
@@ -46,6 +48,7 @@ struct Constraint_ {
     CompareConstraintFunc compare;
     TestConstraintFunc test;
     intptr_t expected;
+    double expected_double;
     intptr_t out_value;
 	int copy_size;
 	CgreenConstraintType constraint_type;
@@ -0,0 +1,19 @@
+#ifndef EVENT_LOG_REPORTER_HEADER
+#define EVENT_LOG_REPORTER_HEADER
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <cgreen/reporter.h>
+
+/* Records the run as binary events, to be shown later by replaying the
+   log into any other reporter. The cgreen-render tool does just that. */
+TestReporter *create_event_log_reporter(const char *path);
+int replay_event_log(const char *path, TestReporter *reporter);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef JUNIT_REPORTER_HEADER
+#define JUNIT_REPORTER_HEADER
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <cgreen/reporter.h>
+
+TestReporter *create_junit_reporter(const char *path);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif
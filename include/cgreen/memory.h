@@ -4,13 +4,22 @@
     extern "C" {
 #endif
 
+#include <stddef.h>
+
 typedef struct MemoryPool_ MemoryPool;
 
 MemoryPool *create_memory_pool();
 void free_memory_pool(MemoryPool *pool);
+void empty_memory_pool(MemoryPool *pool);
 void *memory_pool_allocate(MemoryPool *pool, size_t bytes);
 void *memory_pool_reallocate(MemoryPool *pool, void *pointer, size_t bytes);
 
+/* Memory for the mocks and constraints of the running test. It is all
+   given back at once by clear_mocks(), at the start and end of a test. */
+void *allocate_test_memory(size_t bytes);
+void *reallocate_test_memory(void *pointer, size_t bytes);
+void free_test_memory();
+
 #ifdef __cplusplus
     }
 #endif
@@ -13,9 +13,13 @@
 #include <sys/msg.h>
 #endif
 
+#include <stddef.h>
+
 int start_cgreen_messaging(int tag);
 void send_cgreen_message(int messaging, int result);
+void send_cgreen_message_with_payload(int messaging, int result, const void *payload, size_t size);
 int receive_cgreen_message(int messaging);
+int receive_cgreen_message_with_payload(int messaging, void **payload, size_t *size);
 
 #ifdef __cplusplus
     }
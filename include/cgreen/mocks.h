@@ -23,10 +23,29 @@
 #define will_respond(f, r, ...) will_return_(#f, (intptr_t)r); expect_(#f, __FILE__, __LINE__, (Constraint *)__VA_ARGS__ +0, (Constraint *)0)
 #define always_respond(f, r, ...) always_return_(#f, (intptr_t)r); always_expect_(#f, __FILE__, __LINE__, (Constraint *)__VA_ARGS__ +0, (Constraint *)0)
 
+#define mock_call_count(f) mock_call_count_(#f)
+#define nth_mock_call(f, n) nth_mock_call_(#f, n)
+#define mock_calls_in_order(...) mock_calls_in_order_(#__VA_ARGS__)
+
 #define mock_enabled() mock_enabled_(__func__)
 #define disable_mock(f) disable_mock_(#f)
 #define enable_mock(f) enable_mock_(#f)
 
+#define MOCK_CALL_ARGUMENTS 8
+
+/* Every call to a mock during a test is written down in a journal of
+   the last few thousand calls. The call number counts the calls to the
+   same function from 1, and the sequence counts all mocked calls in the
+   test. Only the first MOCK_CALL_ARGUMENTS arguments are kept. */
+typedef struct {
+    const char *function;
+    int call;
+    int sequence;
+    double time;
+    int argument_count;
+    intptr_t arguments[MOCK_CALL_ARGUMENTS];
+} MockCall;
+
 intptr_t mock_(const char *function, const char *parameters, ...);
 void expect_(const char *function, const char *test_file, int test_line, ...);
 void always_expect_(const char *function, const char *test_file, int test_line, ...);
@@ -35,6 +54,9 @@ void will_return_(const char *function, intptr_t result);
 void always_return_(const char *function, intptr_t result);
 void clear_mocks();
 void tally_mocks(TestReporter *reporter);
+int mock_call_count_(const char *function);
+const MockCall *nth_mock_call_(const char *function, int n);
+int mock_calls_in_order_(const char *functions);
 
 int mock_enabled_(const char *function);
 void disable_mock_(const char *function);
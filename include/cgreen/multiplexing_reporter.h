@@ -0,0 +1,18 @@
+#ifndef MULTIPLEXING_REPORTER_HEADER
+#define MULTIPLEXING_REPORTER_HEADER
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <cgreen/reporter.h>
+
+/* Feeds one run to all of the reporters given, which it then owns and
+   destroys with itself. Should it fail, they are left to the caller. */
+TestReporter *create_multiplexing_reporter(TestReporter **children, int count);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif
@@ -10,6 +10,19 @@
 
 typedef struct TestContext_ TestContext;
 
+/* What one test cost, as seen from the runner. Times are in seconds and
+   the resident size in kilobytes. The counts are those of getrusage(). */
+typedef struct {
+    double wall_time;
+    double user_time;
+    double system_time;
+    long max_resident_kb;
+    long minor_faults;
+    long major_faults;
+    long voluntary_switches;
+    long involuntary_switches;
+} TestMetrics;
+
 typedef struct TestReporter_ TestReporter;
 struct TestReporter_ {
     void (*destroy)(TestReporter *);
@@ -21,6 +34,7 @@ struct TestReporter_ {
     void (*assert_true)(TestReporter *, const char *, int, int, const char *, ...);
 	void (*finish_test)(TestReporter *, const char *);
 	void (*finish_suite)(TestReporter *, const char *);
+	void (*record_metrics)(TestReporter *, const char *, const TestMetrics *);
 	int passes;
 	int failures;
 	int exceptions;
@@ -29,11 +43,19 @@ struct TestReporter_ {
 	int ipc;
 	void *memo;
     void *reporter_context;
+    int unsent_passes;
+    void *relayed_results;
 };
 
 typedef void TestReportMemo;
 
+/* The results of one test or suite as read from the messaging queue,
+   so that they can be passed on to other reporters without reading
+   the queue again */
+typedef struct ReporterResults_ ReporterResults;
+
 TestReporter *get_test_reporter();
+void set_test_reporter(TestReporter *reporter);
 TestReporter *create_reporter();
 int setup_reporting(TestReporter *reporter);
 void destroy_reporter(TestReporter *reporter);
@@ -44,7 +66,12 @@ void reporter_start_suite(TestReporter *reporter, const char *name,
 void reporter_finish(TestReporter *reporter, const char *name);
 void add_reporter_result(TestReporter *reporter, int result);
 void send_reporter_completion_notification(TestReporter *reporter);
+int is_reporter_completion_notification(int message);
 void set_log_depth(TestReporter *reporter, int log_depth);
+ReporterResults *create_reporter_results();
+void destroy_reporter_results(ReporterResults *results);
+ReporterResults *take_reporter_results(TestReporter *reporter, ReporterResults *results);
+void relay_reporter_results(TestReporter *reporter, ReporterResults *results);
 
 #ifdef __cplusplus
     }
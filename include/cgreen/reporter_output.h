@@ -0,0 +1,35 @@
+#ifndef REPORTER_OUTPUT_HEADER
+#define REPORTER_OUTPUT_HEADER
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdarg.h>
+#include <stddef.h>
+
+/* Reporters write through one of these rather than stdio. The text is
+   gathered in a ring and written out in large pieces, either by the
+   runner when it is told to or by a writer thread of its own. */
+typedef struct ReporterOutput_ ReporterOutput;
+
+ReporterOutput *create_reporter_output(int file_descriptor);
+void destroy_reporter_output(ReporterOutput *output);
+void write_reporter_output_in_background(ReporterOutput *output);
+void reporter_output_write(ReporterOutput *output, const char *text, size_t size);
+void reporter_output_printf(ReporterOutput *output, const char *format, ...);
+void reporter_output_vprintf(ReporterOutput *output, const char *format, va_list arguments);
+void reporter_output_event_done(ReporterOutput *output);
+void flush_reporter_output(ReporterOutput *output);
+
+/* Shared by every reporter that writes to stdout, and flushed by the
+   runner whenever the tests' own output could come next */
+ReporterOutput *standard_reporter_output();
+int standard_output_printf(const char *format, ...);
+void flush_standard_reporter_output();
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif
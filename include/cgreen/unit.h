@@ -59,10 +59,92 @@ void add_tests_(TestSuite *suite, const char *names, ...);
 void add_suite_(TestSuite *owner, char *name, TestSuite *suite);
 void setup_(TestSuite *suite, void (*set_up)());
 void teardown_(TestSuite *suite, void (*tear_down)());
+
+/**
+ * @brief Keep forking the tests of a suite when running in process.
+ *
+ * Tests in this suite, and in any suite added to it, still get a
+ * process each under run_test_suite_in_process(). Use it for suites
+ * that leave state behind, or that crash in ways a signal handler
+ * can not recover from.
+ *
+ * @param  suite        The test suite that needs its own processes.
+ */
+void always_fork_tests(TestSuite *suite);
 void die_in(unsigned int seconds);
 int run_test_suite(TestSuite *suite, TestReporter *reporter);
+
+/**
+ * @brief Run a test suite without forking a process for each test.
+ *
+ * A test that crashes with SIGSEGV, SIGBUS, SIGFPE, SIGABRT or SIGILL,
+ * or that runs past its die_in() limit, is abandoned and reported as an
+ * exception, and the run carries on with the next test. The handlers run
+ * on a stack of their own, so a test that overflows the stack is caught
+ * too. Suites marked with always_fork_tests() are forked as usual.
+ * run_test_suite() uses this when CGREEN_IN_PROCESS is set.
+ *
+ * @param  suite        The test suite to run.
+ * @param  reporter     The reporter to send the results to.
+ *
+ * @return EXIT_SUCCESS if nothing failed, EXIT_FAILURE otherwise.
+ */
+int run_test_suite_in_process(TestSuite *suite, TestReporter *reporter);
+
+/**
+ * @brief Run a test suite with several tests in flight at once.
+ *
+ * Up to @a jobs forked tests run at the same time, drawn from the whole
+ * tree of suites. Their results are still passed to the reporter in the
+ * order the tests were added. The setups and teardowns of enclosing
+ * suites run once around each nested suite, as it is reported, in the
+ * runner or in the fork server when there is one. Workers only take and
+ * steal tests that share the same enclosing setups, so a suite with a
+ * setup or teardown of its own keeps the tests of each of its nested
+ * suites to themselves.
+ * run_test_suite() uses this when CGREEN_JOBS is set, and setting
+ * CGREEN_TRACE prints which worker ran or stole each test. Setting
+ * CGREEN_FORK_SERVER has the tests forked by a server process started
+ * before any results are collected, rather than by the runner itself.
+ * Setting CGREEN_BATCH lets one process run several quick tests in a
+ * row, as many as fit in a few hundredths of a second up to the number
+ * given. A test that crashes is still reported as an exception, and the
+ * tests after it are run in a fresh process.
+ *
+ * @param  suite        The test suite to run.
+ * @param  reporter     The reporter to send the results to.
+ * @param  jobs         The most tests to run at once, 1 runs them in turn.
+ *
+ * @return EXIT_SUCCESS if nothing failed, EXIT_FAILURE otherwise.
+ */
+int run_test_suite_parallel(TestSuite *suite, TestReporter *reporter, int jobs);
 int run_single_test(TestSuite *suite, char *test, TestReporter *reporter);
 
+/**
+ * @brief Run only the tests picked out by a list of selections.
+ *
+ * Tests are named by the path of suite names leading to them, leaving
+ * out the suite being run, as in "person_tests/can_be_renamed". A
+ * selection is one of these paths, or a bare test or suite name, which
+ * picks every test or suite of that name. A selection ending in a slash
+ * picks every test in the suite, and one containing '*' or '?' is a
+ * wildcard over the paths, or over bare names if it has no slash. The
+ * tests are looked up in an index built once for the run, and run as
+ * run_single_test() runs its test. run_single_test() is this with one
+ * selection. A path may also start with the name of the suite being
+ * run, as in "all_tests/person_tests/can_be_renamed". A selection that
+ * matches no test is reported, and fails the run.
+ *
+ * @param  suite        The test suite to pick the tests from.
+ * @param  selections   The paths, names and wildcards to run.
+ * @param  count        The number of selections.
+ * @param  reporter     The reporter to send the results to.
+ *
+ * @return EXIT_SUCCESS if nothing failed and every selection matched,
+ *         EXIT_FAILURE otherwise.
+ */
+int run_selected_tests(TestSuite *suite, char **selections, int count, TestReporter *reporter);
+
 /**
  * @}
  */
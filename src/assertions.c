@@ -3,6 +3,14 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <limits.h>
+#include <stdio.h>
+#if defined __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined __AVX2__
+#include <immintrin.h>
+#endif
 
 
 #ifndef max
@@ -12,9 +20,36 @@
     #define min(a,b) ((a) > (b) ? (b) : (a))
 #endif
 
+/* Doubles are compared to within a power of ten below the leading
+   figure of the larger one. The leading figure is found from the
+   binary exponent, and the power built from these, so that no
+   comparison needs a logarithm. */
+static const double exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+static const double binary_powers_of_ten[] = {1e1, 1e2, 1e4, 1e8, 1e16, 1e32, 1e64, 1e128, 1e256};
+#define LARGEST_EXACT_POWER_OF_TEN 22
+#define LARGEST_POWER_OF_TEN 511
+
 static double accuracy(int significant_figures, double largest);
+static int decimal_exponent(double magnitude);
+static double power_of_ten(int exponent);
+static long long ordered_bits(double d);
+
+/* A whole buffer makes one assertion, with the values either side of
+   the first difference shown on failure */
+#define WINDOW_BYTES 8
+#define WINDOW_ITEMS 3
+#define WINDOW_TEXT 256
+
+static size_t first_difference(const unsigned char *tried, const unsigned char *expected, size_t size);
+static void window_around(size_t at, size_t count, size_t width, size_t *start, size_t *end);
+static void show_bytes(char *text, const unsigned char *bytes, size_t at, size_t size);
+static void show_ints(char *text, const int *items, size_t at, size_t count);
+static void show_doubles(char *text, const double *items, size_t at, size_t count);
 
 static int significant_figures = 8;
+static int units_in_last_place = 0;
 
 void assert_equal_(const char *file, int line, intptr_t tried, intptr_t expected) {
     (*get_test_reporter()->assert_true)(
@@ -40,7 +75,12 @@ void assert_double_equal_(const char *file, int line, double tried, double expec
             file,
             line,
             doubles_are_equal(tried, expected),
-            "[%f] should match [%f] within %d significant figures %f", tried, expected, significant_figures);
+            units_in_last_place > 0 ?
+                "[%f] should match [%f] within %d units in the last place" :
+                "[%f] should match [%f] within %d significant figures",
+            tried,
+            expected,
+            units_in_last_place > 0 ? units_in_last_place : significant_figures);
 }
 
 void assert_double_not_equal_(const char *file, int line, double tried, double expected) {
@@ -49,7 +89,12 @@ void assert_double_not_equal_(const char *file, int line, double tried, double e
             file,
             line,
             ! doubles_are_equal(tried, expected),
-            "[%f] should not match [%f] within %d significant figures", tried, expected, significant_figures);
+            units_in_last_place > 0 ?
+                "[%f] should not match [%f] within %d units in the last place" :
+                "[%f] should not match [%f] within %d significant figures",
+            tried,
+            expected,
+            units_in_last_place > 0 ? units_in_last_place : significant_figures);
 }
 
 void assert_string_equal_(const char *file, int line, const char *tried, const char *expected) {
@@ -70,8 +115,75 @@ void assert_string_not_equal_(const char *file, int line, const char *tried, con
             "[%s] should not match [%s]", show_null_as_the_string_null(tried), show_null_as_the_string_null(expected));
 }
 
+void assert_memory_equal_(const char *file, int line, const void *tried, const void *expected, size_t size) {
+    size_t difference = first_difference((const unsigned char *)tried, (const unsigned char *)expected, size);
+    char tried_window[WINDOW_TEXT] = "";
+    char expected_window[WINDOW_TEXT] = "";
+    if (difference < size) {
+        show_bytes(tried_window, (const unsigned char *)tried, difference, size);
+        show_bytes(expected_window, (const unsigned char *)expected, difference, size);
+    }
+    (*get_test_reporter()->assert_true)(
+            get_test_reporter(),
+            file,
+            line,
+            difference == size,
+            "Memory differs at byte [%lu] of [%lu]: [%s] should match [%s]",
+            (unsigned long)difference, (unsigned long)size, tried_window, expected_window);
+}
+
+void assert_int_array_equal_(const char *file, int line, const int *tried, const int *expected, size_t count) {
+    size_t difference = first_difference((const unsigned char *)tried, (const unsigned char *)expected, count * sizeof(int)) / sizeof(int);
+    char tried_window[WINDOW_TEXT] = "";
+    char expected_window[WINDOW_TEXT] = "";
+    if (difference < count) {
+        show_ints(tried_window, tried, difference, count);
+        show_ints(expected_window, expected, difference, count);
+    }
+    (*get_test_reporter()->assert_true)(
+            get_test_reporter(),
+            file,
+            line,
+            difference == count,
+            "Arrays differ at index [%lu] of [%lu]: [%s] should match [%s]",
+            (unsigned long)difference, (unsigned long)count, tried_window, expected_window);
+}
+
+/* Identical runs are skipped as memory, and only the elements that
+   differ in their bits are compared as doubles */
+void assert_double_array_equal_(const char *file, int line, const double *tried, const double *expected, size_t count) {
+    size_t difference = 0;
+    char tried_window[WINDOW_TEXT] = "";
+    char expected_window[WINDOW_TEXT] = "";
+    for (;;) {
+        difference += first_difference((const unsigned char *)(tried + difference),
+                                       (const unsigned char *)(expected + difference),
+                                       (count - difference) * sizeof(double)) / sizeof(double);
+        if (difference == count || ! doubles_are_equal(tried[difference], expected[difference])) {
+            break;
+        }
+        difference++;
+    }
+    if (difference < count) {
+        show_doubles(tried_window, tried, difference, count);
+        show_doubles(expected_window, expected, difference, count);
+    }
+    (*get_test_reporter()->assert_true)(
+            get_test_reporter(),
+            file,
+            line,
+            difference == count,
+            "Arrays differ at index [%lu] of [%lu]: [%s] should match [%s]",
+            (unsigned long)difference, (unsigned long)count, tried_window, expected_window);
+}
+
 void significant_figures_for_assert_double_are(int figures) {
     significant_figures = figures;
+    units_in_last_place = 0;
+}
+
+void units_in_last_place_for_assert_double_are(int units) {
+    units_in_last_place = units;
 }
 
 const char *show_null_as_the_string_null(const char *string) {
@@ -86,12 +198,157 @@ int strings_are_equal(const char *tried, const char *expected) {
     }
 }
 
+/* Equal values always match, whatever their sign, and NaN never does */
 int doubles_are_equal(const double tried, const double expected) {
-    return max(tried, expected) - min(tried, expected) < accuracy(significant_figures, max(tried, expected));
+    long long first, second;
+    if (tried == expected) {
+        return 1;
+    }
+    if (tried != tried || expected != expected) {
+        return 0;
+    }
+    if (units_in_last_place > 0) {
+        first = ordered_bits(tried);
+        second = ordered_bits(expected);
+        return (first > second ? (unsigned long long)first - second : (unsigned long long)second - first) <= (unsigned long long)units_in_last_place;
+    }
+    return fabs(tried - expected) < accuracy(significant_figures, max(fabs(tried), fabs(expected)));
 }
 
 static double accuracy(int figures, double largest) {
-    return pow(10, 1 + (int)log10(largest) - figures);
+    return power_of_ten(decimal_exponent(largest) + 1 - figures);
+}
+
+/* The binary exponent, times 78913 / 2^18 for log10(2), puts the
+   decimal one within a step either way */
+static int decimal_exponent(double magnitude) {
+    unsigned long long bits;
+    int binary;
+    int exponent;
+    memcpy(&bits, &magnitude, sizeof(double));
+    binary = (int)((bits >> 52) & 0x7ff) - 1023;
+    if (binary == -1023) {
+        frexp(magnitude, &binary);
+        binary--;
+    }
+    exponent = ((binary * 78913 + (1 << 30)) >> 18) - (1 << 12);
+    if (magnitude >= power_of_ten(exponent + 1)) {
+        exponent++;
+    } else if (magnitude < power_of_ten(exponent)) {
+        exponent--;
+    }
+    return exponent;
+}
+
+static double power_of_ten(int exponent) {
+    int magnitude = exponent < 0 ? -exponent : exponent;
+    double power = 1;
+    int i;
+    if (magnitude <= LARGEST_EXACT_POWER_OF_TEN) {
+        return exponent < 0 ? 1 / exact_powers_of_ten[magnitude] : exact_powers_of_ten[magnitude];
+    }
+    if (magnitude > LARGEST_POWER_OF_TEN) {
+        return exponent < 0 ? 0 : HUGE_VAL;
+    }
+    for (i = 0; magnitude != 0; i++, magnitude >>= 1) {
+        if (magnitude & 1) {
+            power = exponent < 0 ? power / binary_powers_of_ten[i] : power * binary_powers_of_ten[i];
+        }
+    }
+    return power;
+}
+
+/* The bits of a double as an integer that orders the same way, so that
+   neighbouring doubles are one apart, across zero as well */
+static long long ordered_bits(double d) {
+    long long bits;
+    memcpy(&bits, &d, sizeof(double));
+    return bits < 0 ? LLONG_MIN - bits : bits;
+}
+
+/* Whole blocks are compared at a time while they match, and then
+   narrowed down to the byte that differs. The vector blocks are used
+   where the compiler targets them. */
+static size_t first_difference(const unsigned char *tried, const unsigned char *expected, size_t size) {
+    size_t i = 0;
+    size_t tried_word, expected_word;
+#if defined __AVX2__
+    for (; i + 128 <= size; i += 128) {
+        __m256i same = _mm256_and_si256(
+                _mm256_and_si256(
+                        _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(tried + i)), _mm256_loadu_si256((const __m256i *)(expected + i))),
+                        _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(tried + i + 32)), _mm256_loadu_si256((const __m256i *)(expected + i + 32)))),
+                _mm256_and_si256(
+                        _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(tried + i + 64)), _mm256_loadu_si256((const __m256i *)(expected + i + 64))),
+                        _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(tried + i + 96)), _mm256_loadu_si256((const __m256i *)(expected + i + 96)))));
+        if ((unsigned int)_mm256_movemask_epi8(same) != 0xffffffffu) {
+            break;
+        }
+    }
+#endif
+#if defined __SSE2__
+    for (; i + 64 <= size; i += 64) {
+        __m128i same = _mm_and_si128(
+                _mm_and_si128(
+                        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(tried + i)), _mm_loadu_si128((const __m128i *)(expected + i))),
+                        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(tried + i + 16)), _mm_loadu_si128((const __m128i *)(expected + i + 16)))),
+                _mm_and_si128(
+                        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(tried + i + 32)), _mm_loadu_si128((const __m128i *)(expected + i + 32))),
+                        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(tried + i + 48)), _mm_loadu_si128((const __m128i *)(expected + i + 48)))));
+        if (_mm_movemask_epi8(same) != 0xffff) {
+            break;
+        }
+    }
+#endif
+    for (; i + sizeof(size_t) <= size; i += sizeof(size_t)) {
+        memcpy(&tried_word, tried + i, sizeof(size_t));
+        memcpy(&expected_word, expected + i, sizeof(size_t));
+        if (tried_word != expected_word) {
+            break;
+        }
+    }
+    for (; i < size; i++) {
+        if (tried[i] != expected[i]) {
+            return i;
+        }
+    }
+    return size;
+}
+
+static void window_around(size_t at, size_t count, size_t width, size_t *start, size_t *end) {
+    *start = at > width ? at - width : 0;
+    *end = count - at > width ? at + width + 1 : count;
+}
+
+/* The differing value is marked as <value>, and cut ends as ... */
+static void show_bytes(char *text, const unsigned char *bytes, size_t at, size_t size) {
+    size_t start, end, i;
+    window_around(at, size, WINDOW_BYTES, &start, &end);
+    text += sprintf(text, "%s", start > 0 ? "... " : "");
+    for (i = start; i < end; i++) {
+        text += sprintf(text, i == at ? "%s<%02x>" : "%s%02x", i > start ? " " : "", bytes[i]);
+    }
+    sprintf(text, "%s", end < size ? " ..." : "");
+}
+
+static void show_ints(char *text, const int *items, size_t at, size_t count) {
+    size_t start, end, i;
+    window_around(at, count, WINDOW_ITEMS, &start, &end);
+    text += sprintf(text, "%s", start > 0 ? "... " : "");
+    for (i = start; i < end; i++) {
+        text += sprintf(text, i == at ? "%s<%d>" : "%s%d", i > start ? " " : "", items[i]);
+    }
+    sprintf(text, "%s", end < count ? " ..." : "");
+}
+
+static void show_doubles(char *text, const double *items, size_t at, size_t count) {
+    size_t start, end, i;
+    window_around(at, count, WINDOW_ITEMS, &start, &end);
+    text += sprintf(text, "%s", start > 0 ? "... " : "");
+    for (i = start; i < end; i++) {
+        text += sprintf(text, i == at ? "%s<%g>" : "%s%g", i > start ? " " : "", items[i]);
+    }
+    sprintf(text, "%s", end < count ? " ..." : "");
 }
 
 /* vim: set ts=4 sw=4 et cindent: */
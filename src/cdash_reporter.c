@@ -1,6 +1,7 @@
 #include <cgreen/cdash_reporter.h>
 #include <cgreen/reporter.h>
 #include <cgreen/breadcrumb.h>
+#include "reporter_helpers.h"
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -9,22 +10,31 @@
 #include <time.h>
 #include <string.h>
 
+#ifndef va_copy
+#define va_copy(copy, original) ((copy) = (original))
+#endif
+
+/* Test.xml is written through a large buffer and flushed when the run
+   is over, rather than after every test */
+#define REPORT_BUFFER_SIZE 65536
+
 typedef int Printer(FILE *, const char *format, ...);
-typedef time_t Timer(char *strtime);
-typedef double DiffTimer(time_t t1, time_t t2);
 
+/* One <Test> is written per test, once its results are in. Failures are
+   gathered in a buffer that grows to hold them until then. */
 typedef struct {
-	CDashInfo *cdash;
-	Printer *printer;
-	Timer *timer;
-	DiffTimer *difftimer;
-	int  pipe_fd[2];
-	time_t begin;
-	time_t startdatetime;
-	time_t enddatetime;
-	time_t teststarted;
-	time_t testfinished;
-	FILE *f_reporter;
+    CDashInfo *cdash;
+    Printer *printer;
+    FILE *f_reporter;
+    char *report_buffer;
+    double run_started;
+    double test_started;
+    double test_time;
+    int test_measured;
+    int test_completed;
+    char *failures;
+    size_t failures_size;
+    size_t failures_space;
 } CdashMemo;
 
 static void cdash_destroy_reporter(TestReporter *reporter);
@@ -32,246 +42,287 @@ static void cdash_reporter_suite_started(TestReporter *reporter, const char *nam
 static void cdash_reporter_testcase_started(TestReporter *reporter, const char *name);
 
 static void show_failed(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments);
-static void show_passed(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments);
 static void show_incomplete(TestReporter *reporter, const char *name);
+static void record_metrics(TestReporter *reporter, const char *name, const TestMetrics *metrics);
 
 static void cdash_reporter_testcase_finished(TestReporter *reporter, const char *name);
 static void cdash_reporter_suite_finished(TestReporter *reporter, const char *name);
 
-static time_t cdash_build_stamp(char *sbuildstamp, size_t sb);
-static time_t cdash_current_time(char *strtime);
-static double cdash_enlapsed_time(time_t t1, time_t t2);
+static void write_test(TestReporter *reporter, const char *name, int failed, double exectime);
+static void add_failure(CdashMemo *memo, const char *format, ...);
+static void add_failure_text(CdashMemo *memo, const char *format, va_list arguments);
+static void write_escaped(CdashMemo *memo, const char *text);
+static void write_to_file(void *file, const char *text, size_t size);
+static void write_full_name(const char *name, void *abstract_memo);
+static int make_directory(const char *path);
+static void cdash_build_stamp(char *sbuildstamp, size_t sb);
+static void cdash_current_time(char *strtime, size_t size);
 
 TestReporter *create_cdash_reporter(CDashInfo *cdash) {
-	TestReporter *reporter;
-	CdashMemo *memo;
-	FILE *fd;
-	char sbuildstamp[15];
-	char strstart[30];
-	char reporter_path[255];
-	int rep_dir, strsize;
-
-	if (!cdash)
-		return NULL;
-
-	reporter = create_reporter();
-	if (!reporter)
-		return NULL;
-
-    memo = (CdashMemo *) malloc(sizeof(CdashMemo));
-    if (!memo)
-    	return NULL;
-
-    memo->cdash = (CDashInfo *) cdash;
-
-    memo->printer = fprintf;
-    memo->timer = cdash_current_time;
-    memo->difftimer = cdash_enlapsed_time;
-    memo->begin = cdash_build_stamp(sbuildstamp, 15);
+    TestReporter *reporter;
+    CdashMemo *memo;
+    FILE *fd;
+    char sbuildstamp[15];
+    char strstart[30];
+    char reporter_path[255];
+
+    if (!cdash)
+        return NULL;
 
-    rep_dir = mkdir("./Testing", S_IXUSR|S_IRUSR|S_IWUSR|S_IXGRP|S_IRGRP|S_IXOTH|S_IRGRP);
-    if (rep_dir)
-      if (errno != EEXIST)
+    cdash_build_stamp(sbuildstamp, sizeof(sbuildstamp));
+    if (!make_directory("./Testing"))
         return NULL;
 
     fd = fopen("./Testing/TAG", "w+");
     if (fd == NULL)
-      return NULL;
-
-    fprintf(fd,"%s\n%s\n", sbuildstamp, memo->cdash->type);
-
+        return NULL;
+    fprintf(fd, "%s\n%s\n", sbuildstamp, cdash->type);
     fclose(fd);
 
-    strsize = snprintf(reporter_path, 255, "./Testing/%s", sbuildstamp);
-
-    rep_dir = mkdir(reporter_path, S_IXUSR|S_IRUSR|S_IWUSR|S_IXGRP|S_IRGRP|S_IXOTH|S_IRGRP);
-    if (rep_dir)
-      if (errno != EEXIST)
+    snprintf(reporter_path, sizeof(reporter_path), "./Testing/%s", sbuildstamp);
+    if (!make_directory(reporter_path))
         return NULL;
 
-    strsize = snprintf( (char *) (reporter_path + strsize), (255 - strsize), "/Test.xml");
-
+    strncat(reporter_path, "/Test.xml", sizeof(reporter_path) - strlen(reporter_path) - 1);
     fd = fopen(reporter_path, "w+");
     if (fd == NULL)
-      return NULL;
+        return NULL;
 
-    /* now the Test.xml is in place */
-    memo->f_reporter = fd;
+    reporter = create_reporter();
+    if (!reporter) {
+        fclose(fd);
+        return NULL;
+    }
 
-    memo->startdatetime = cdash_current_time(strstart);
-
-	memo->printer(memo->f_reporter,
-			"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
-			" <Site BuildName=\"%s\" BuildStamp=\"%s-%s\" Name=\"%s\" Generator=\"%s\""
-			" OSName=\"%s\" Hostname=\"%s\" OSRelease=\"%s\""
-			" OSVersion=\"%s\" OSPlatform=\"%s\""
-			" Is64Bits=\"\" VendorString=\"\" VendorID=\"\""
-			" FamilyID=\"\" ModelID=\"\" ProcessorCacheSize=\"\" NumberOfLogicalCPU=\"\""
-			" NumberOfPhysicalCPU=\"\" TotalVirtualMemory=\"\" TotalPhysicalMemory=\"\""
-			" LogicalProcessorsPerPhysical=\"\" ProcessorClockFrequency=\"\" >\n"
-			"  <Testing>\n"
-			"   <StartDateTime>%s</StartDateTime>\n"
-			"    <TestList>\n"
-			"     <Test></Test>\n"
-			"    </TestList>\n",
-			memo->cdash->build, sbuildstamp, memo->cdash->type, memo->cdash->name, "Cgreen1.0.0",
-			memo->cdash->os_name, memo->cdash->hostname, memo->cdash->os_release,
-			memo->cdash->os_version, memo->cdash->os_platform, strstart);
-
-	fflush(memo->f_reporter);
+    memo = (CdashMemo *) malloc(sizeof(CdashMemo));
+    if (!memo) {
+        fclose(fd);
+        destroy_reporter(reporter);
+        return NULL;
+    }
+
+    memo->cdash = (CDashInfo *) cdash;
+    memo->printer = fprintf;
+    memo->f_reporter = fd;
+    memo->report_buffer = (char *) malloc(REPORT_BUFFER_SIZE);
+    if (memo->report_buffer != NULL)
+        setvbuf(memo->f_reporter, memo->report_buffer, _IOFBF, REPORT_BUFFER_SIZE);
+    memo->run_started = monotonic_seconds_now();
+    memo->test_started = memo->run_started;
+    memo->test_time = 0.0;
+    memo->test_measured = 0;
+    memo->test_completed = 1;
+    memo->failures = NULL;
+    memo->failures_size = 0;
+    memo->failures_space = 0;
+
+    cdash_current_time(strstart, sizeof(strstart));
+
+    memo->printer(memo->f_reporter,
+            "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            " <Site BuildName=\"%s\" BuildStamp=\"%s-%s\" Name=\"%s\" Generator=\"%s\""
+            " OSName=\"%s\" Hostname=\"%s\" OSRelease=\"%s\""
+            " OSVersion=\"%s\" OSPlatform=\"%s\""
+            " Is64Bits=\"\" VendorString=\"\" VendorID=\"\""
+            " FamilyID=\"\" ModelID=\"\" ProcessorCacheSize=\"\" NumberOfLogicalCPU=\"\""
+            " NumberOfPhysicalCPU=\"\" TotalVirtualMemory=\"\" TotalPhysicalMemory=\"\""
+            " LogicalProcessorsPerPhysical=\"\" ProcessorClockFrequency=\"\" >\n"
+            "  <Testing>\n"
+            "   <StartDateTime>%s</StartDateTime>\n"
+            "   <StartTestTime>%ld</StartTestTime>\n"
+            "    <TestList>\n"
+            "     <Test></Test>\n"
+            "    </TestList>\n",
+            memo->cdash->build, sbuildstamp, memo->cdash->type, memo->cdash->name, "Cgreen1.0.0",
+            memo->cdash->os_name, memo->cdash->hostname, memo->cdash->os_release,
+            memo->cdash->os_version, memo->cdash->os_platform, strstart, (long) time(NULL));
 
     reporter->destroy = &cdash_destroy_reporter;
-	reporter->start_suite = &cdash_reporter_suite_started;
-	reporter->start_test = &cdash_reporter_testcase_started;
-	reporter->show_fail = &show_failed;
-	reporter->show_pass = &show_passed;
-	reporter->show_incomplete = &show_incomplete;
-	reporter->finish_test = &cdash_reporter_testcase_finished;
-	reporter->finish_suite = &cdash_reporter_suite_finished;
-	reporter->memo = memo;
+    reporter->start_suite = &cdash_reporter_suite_started;
+    reporter->start_test = &cdash_reporter_testcase_started;
+    reporter->show_fail = &show_failed;
+    reporter->show_incomplete = &show_incomplete;
+    reporter->record_metrics = &record_metrics;
+    reporter->finish_test = &cdash_reporter_testcase_finished;
+    reporter->finish_suite = &cdash_reporter_suite_finished;
+    reporter->memo = memo;
 
     return reporter;
 }
 
 static void cdash_destroy_reporter(TestReporter *reporter) {
-	char endtime[30];
-
-	CdashMemo *memo = (CdashMemo *)reporter->memo;
-
-	memo->enddatetime = cdash_current_time(endtime);
-
-	memo->printer(memo->f_reporter, "  <EndDateTime>%s</EndDateTime>\n"
-			" <ElapsedMinutes>%.2f</ElapsedMinutes>\n"
-			" </Testing>\n"
-			"</Site>\n", endtime, memo->difftimer(memo->startdatetime, memo->enddatetime));
-
-	destroy_reporter(reporter);
+    char endtime[30];
+    CdashMemo *memo = (CdashMemo *)reporter->memo;
+
+    cdash_current_time(endtime, sizeof(endtime));
+
+    memo->printer(memo->f_reporter, "  <EndDateTime>%s</EndDateTime>\n"
+            "  <EndTestTime>%ld</EndTestTime>\n"
+            " <ElapsedMinutes>%.2f</ElapsedMinutes>\n"
+            " </Testing>\n"
+            "</Site>\n", endtime, (long) time(NULL), (monotonic_seconds_now() - memo->run_started) / 60);
+
+    fclose(memo->f_reporter);
+    free(memo->report_buffer);
+    free(memo->failures);
+    free(memo);
+    reporter->memo = NULL;
+    destroy_reporter(reporter);
 }
 
-
 static void cdash_reporter_suite_started(TestReporter *reporter, const char *name, const int number_of_tests) {
-	reporter_start(reporter, name);
+    reporter_start(reporter, name);
 }
 
 static void cdash_reporter_testcase_started(TestReporter *reporter, const char *name) {
-	CdashMemo *memo = (CdashMemo *)reporter->memo;
-	memo->teststarted = memo->timer(NULL);
-	reporter_start(reporter, name);
+    CdashMemo *memo = (CdashMemo *)reporter->memo;
+    memo->test_started = monotonic_seconds_now();
+    memo->test_measured = 0;
+    memo->test_completed = 1;
+    memo->failures_size = 0;
+    reporter_start(reporter, name);
 }
 
 static void show_failed(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments) {
-	const char *name;
-	char buffer[1000];
-	float exectime;
-	CdashMemo *memo;
-
-	memo = (CdashMemo *)reporter->memo;
-
-	memo->testfinished = memo->timer(NULL);
-
-	exectime = memo->difftimer(memo->teststarted, memo->testfinished);
-
-	name = get_current_from_breadcrumb((CgreenBreadcrumb *)reporter->breadcrumb);
-
-	memo->printer(memo->f_reporter,
-		   "    <Test Status=\"failed\">\n");
-	memo->printer(memo->f_reporter,
-		   "     <Name>%s</Name>\n"
-		   "      <Path>%s</Path>\n"
-		   "      <FullName>%s</FullName>\n"
-		   "      <FullCommandLine>at [%s] line [%d]</FullCommandLine>\n", name, file, file, file, line);
-	memo->printer(memo->f_reporter,
-		   "      <Results>\n"
-		   "       <NamedMeasurement type=\"numeric/double\" name=\"Execution Time\"><Value>%f</Value></NamedMeasurement>\n"
-		   "       <NamedMeasurement type=\"text/string\" name=\"Completion Status\"><Value>Completed</Value></NamedMeasurement>\n"
-		   "       <NamedMeasurement type=\"text/string\" name=\"Command Line\"><Value>%s</Value></NamedMeasurement>\n"
-		   "       <Measurement>\n"
-		   "        <Value>", exectime, name);
-	vsprintf(buffer, (message == NULL ? "Problem" : message), arguments);
-	memo->printer(memo->f_reporter, "%s", buffer);
-	memo->printer(memo->f_reporter, "</Value>\n"
-		   "       </Measurement>\n"
-		   "      </Results>\n"
-	       "    </Test>\n");
-}
-
-static void show_passed(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments) {
-	float exectime;
-	CdashMemo *memo = (CdashMemo *)reporter->memo;
-	const char *name = get_current_from_breadcrumb((CgreenBreadcrumb *)reporter->breadcrumb);
-
-	memo->testfinished = memo->timer(NULL);
-	exectime = memo->difftimer(memo->teststarted, memo->testfinished);
-
-	memo->printer(memo->f_reporter,
-		   "    <Test Status=\"passed\">\n");
-	memo->printer(memo->f_reporter, ""
-		   "     <Name>%s</Name>\n"
-		   "     <Path>%s</Path>\n"
-		   "     <FullName>%s</FullName>\n"
-		   "     <FullCommandLine>at [%s] line [%d]</FullCommandLine>\n", name, file, file, file, line);
-	memo->printer(memo->f_reporter,
-		   "     <Results>\n"
-		   "      <NamedMeasurement type=\"numeric/double\" name=\"Execution Time\"><Value>%f</Value></NamedMeasurement>\n"
-		   "      <NamedMeasurement type=\"text/string\" name=\"Completion Status\"><Value>Completed</Value></NamedMeasurement>\n"
-		   "      <NamedMeasurement type=\"text/string\" name=\"Command Line\"><Value>%s</Value></NamedMeasurement>\n"
-		   "      <Measurement>\n"
-		   "       <Value></Value>\n"
-		   "      </Measurement>\n"
-		   "     </Results>\n"
-	       "    </Test>\n", exectime, name);
+    CdashMemo *memo = (CdashMemo *)reporter->memo;
+    add_failure(memo, "%s:%d: ", file, line);
+    add_failure_text(memo, (message == NULL ? "Problem" : message), arguments);
+    add_failure(memo, "\n");
 }
 
 static void show_incomplete(TestReporter *reporter, const char *name) {
-
+    CdashMemo *memo = (CdashMemo *)reporter->memo;
+    memo->test_completed = 0;
+    add_failure(memo, "Test \"%s\" failed to complete\n", name);
 }
 
+/* The runner measures the test where it ran, which is better than the
+   time from start to finish here once tests run in parallel */
+static void record_metrics(TestReporter *reporter, const char *name, const TestMetrics *metrics) {
+    CdashMemo *memo = (CdashMemo *)reporter->memo;
+    (void) name;
+    memo->test_time = metrics->wall_time;
+    memo->test_measured = 1;
+}
 
 static void cdash_reporter_testcase_finished(TestReporter *reporter, const char *name) {
-	reporter_finish(reporter, name);
-}
+    CdashMemo *memo = (CdashMemo *)reporter->memo;
+    double exectime = memo->test_measured ? memo->test_time : monotonic_seconds_now() - memo->test_started;
+    int failures = reporter->failures + reporter->exceptions;
 
+    reporter_finish(reporter, name);
+    failures = reporter->failures + reporter->exceptions - failures;
+    write_test(reporter, name, failures > 0, exectime);
+}
 
+/* Failures outside of any test, in a suite's own set up, say, are shown
+   as a test named after the suite */
 static void cdash_reporter_suite_finished(TestReporter *reporter, const char *name) {
-	reporter_finish(reporter, name);
+    CdashMemo *memo = (CdashMemo *)reporter->memo;
+    reporter_finish(reporter, name);
+    if (memo->failures_size > 0)
+        write_test(reporter, name, 1, 0.0);
+    if (get_breadcrumb_depth((CgreenBreadcrumb *)reporter->breadcrumb) == 0)
+        fflush(memo->f_reporter);
 }
 
-static time_t cdash_build_stamp(char *sbuildstamp, size_t sb) {
-	time_t t1;
-	struct tm d1;
-	char s[15];
+static void write_test(TestReporter *reporter, const char *name, int failed, double exectime) {
+    CdashMemo *memo = (CdashMemo *)reporter->memo;
+
+    memo->printer(memo->f_reporter, "    <Test Status=\"%s\">\n     <Name>", failed ? "failed" : "passed");
+    write_escaped(memo, name);
+    memo->printer(memo->f_reporter, "</Name>\n     <Path>.</Path>\n     <FullName>");
+    walk_breadcrumb((CgreenBreadcrumb *)reporter->breadcrumb, &write_full_name, memo);
+    write_escaped(memo, name);
+    memo->printer(memo->f_reporter, "</FullName>\n     <FullCommandLine></FullCommandLine>\n"
+            "     <Results>\n"
+            "      <NamedMeasurement type=\"numeric/double\" name=\"Execution Time\"><Value>%.9f</Value></NamedMeasurement>\n"
+            "      <NamedMeasurement type=\"text/string\" name=\"Completion Status\"><Value>%s</Value></NamedMeasurement>\n"
+            "      <Measurement>\n"
+            "       <Value>",
+            exectime, memo->test_completed ? "Completed" : "Failed to complete");
+    if (memo->failures_size > 0)
+        write_escaped(memo, memo->failures);
+    memo->printer(memo->f_reporter, "</Value>\n"
+            "      </Measurement>\n"
+            "     </Results>\n"
+            "    </Test>\n");
+
+    memo->failures_size = 0;
+    memo->test_measured = 0;
+    memo->test_completed = 1;
+}
 
-	t1 = time(0);
-	gmtime_r(&t1, &d1);
+static void add_failure(CdashMemo *memo, const char *format, ...) {
+    va_list arguments;
+    va_start(arguments, format);
+    add_failure_text(memo, format, arguments);
+    va_end(arguments);
+}
 
-	strftime(s, sizeof(s), "%Y%m%d-%H%M", &d1);
-	snprintf(sbuildstamp, sb, "%s", s);
+static void add_failure_text(CdashMemo *memo, const char *format, va_list arguments) {
+    va_list copy;
+    int length;
+    size_t space;
+    char *failures;
+
+    va_copy(copy, arguments);
+    length = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+    if (length < 0)
+        return;
+
+    if (memo->failures_size + length + 1 > memo->failures_space) {
+        space = (memo->failures_space == 0 ? 256 : memo->failures_space);
+        while (space < memo->failures_size + length + 1)
+            space *= 2;
+        failures = (char *) realloc(memo->failures, space);
+        if (failures == NULL)
+            return;
+        memo->failures = failures;
+        memo->failures_space = space;
+    }
+    vsnprintf(memo->failures + memo->failures_size, length + 1, format, arguments);
+    memo->failures_size += length;
+}
 
-	return t1;
+static void write_escaped(CdashMemo *memo, const char *text) {
+    write_xml_escaped(&write_to_file, memo->f_reporter, text);
 }
 
-static time_t cdash_current_time(char *strtime) {
-	time_t t1;
-	struct tm d1;
-	char s[20];
-	size_t i;
+static void write_to_file(void *file, const char *text, size_t size) {
+    fwrite(text, 1, size, (FILE *)file);
+}
 
-	t1 = time(0);
-	gmtime_r(&t1, &d1);
+/* The full name of a test is the path of suites leading to it */
+static void write_full_name(const char *name, void *abstract_memo) {
+    CdashMemo *memo = (CdashMemo *)abstract_memo;
+    write_escaped(memo, name);
+    memo->printer(memo->f_reporter, "/");
+}
 
-	if(strtime == NULL)
-		return t1;
+static int make_directory(const char *path) {
+    if (mkdir(path, S_IXUSR|S_IRUSR|S_IWUSR|S_IXGRP|S_IRGRP|S_IXOTH|S_IROTH) != 0 && errno != EEXIST)
+        return 0;
+    return 1;
+}
 
-	i = strftime(s, 20, "%b %d %H:%M EDT", &d1);
+static void cdash_build_stamp(char *sbuildstamp, size_t sb) {
+    time_t t1;
+    struct tm d1;
 
-	strncpy(strtime, s, i+1);
+    t1 = time(0);
+    gmtime_r(&t1, &d1);
 
-	return t1;
+    strftime(sbuildstamp, sb, "%Y%m%d-%H%M", &d1);
 }
 
-static double cdash_enlapsed_time(time_t t1, time_t t2) {
-	double diff;
+static void cdash_current_time(char *strtime, size_t size) {
+    time_t t1;
+    struct tm d1;
+
+    t1 = time(0);
+    gmtime_r(&t1, &d1);
 
-	diff = difftime(t2, t1);
-	return (diff == 0 ? 0 : (diff / 60));
+    strftime(strtime, size, "%b %d %H:%M UTC", &d1);
 }
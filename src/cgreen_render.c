@@ -0,0 +1,94 @@
+#include <cgreen/event_log_reporter.h>
+#include <cgreen/text_reporter.h>
+#include <cgreen/cute_reporter.h>
+#include <cgreen/cdash_reporter.h>
+#include <cgreen/junit_reporter.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#if !defined WINCE && !defined WIN32
+#include <sys/utsname.h>
+#include <unistd.h>
+#endif
+
+/* Shows a log written by the event log reporter with any of the other
+   reporters, as if the tests were running now */
+
+static void usage(const char *program);
+static TestReporter *create_cdash_reporter_for(const char *log_path);
+
+int main(int argc, char **argv) {
+    const char *format = "text";
+    const char *output = "junit.xml";
+    const char *log_path = NULL;
+    TestReporter *reporter;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            format = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (argv[i][0] != '-' && log_path == NULL) {
+            log_path = argv[i];
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (log_path == NULL) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (strcmp(format, "text") == 0) {
+        reporter = create_text_reporter();
+    } else if (strcmp(format, "cute") == 0) {
+        reporter = create_cute_reporter();
+    } else if (strcmp(format, "cdash") == 0) {
+        reporter = create_cdash_reporter_for(log_path);
+    } else if (strcmp(format, "junit") == 0) {
+        reporter = create_junit_reporter(output);
+    } else {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (reporter == NULL) {
+        fprintf(stderr, "%s: could not create the %s reporter\n", argv[0], format);
+        return EXIT_FAILURE;
+    }
+    return replay_event_log(log_path, reporter);
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [-f text|cute|cdash|junit] [-o junit-file] event-log\n", program);
+}
+
+/* The build is named after the log and the site after this machine */
+static TestReporter *create_cdash_reporter_for(const char *log_path) {
+    static CDashInfo cdash;
+#if !defined WINCE && !defined WIN32
+    static struct utsname system;
+    static char hostname[256];
+    if (uname(&system) == 0) {
+        cdash.os_name = system.sysname;
+        cdash.os_release = system.release;
+        cdash.os_version = system.version;
+        cdash.os_platform = system.machine;
+    }
+    if (gethostname(hostname, sizeof(hostname)) == 0) {
+        hostname[sizeof(hostname) - 1] = '\0';
+        cdash.hostname = hostname;
+    }
+#endif
+    if (cdash.hostname == NULL) {
+        cdash.hostname = "";
+    }
+    cdash.name = cdash.hostname;
+    cdash.build = (char *)log_path;
+    cdash.type = "Experimental";
+    if (cdash.os_name == NULL) {
+        cdash.os_name = cdash.os_release = cdash.os_version = cdash.os_platform = "";
+    }
+    return create_cdash_reporter(&cdash);
+}
@@ -1,5 +1,6 @@
 #include <cgreen/constraint.h>
 #include <cgreen/assertions.h>
+#include <cgreen/memory.h>
 
 #if defined WINCE || defined WIN32
 #include <crtdefs.h>
@@ -10,6 +11,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined INTPTR_MAX && defined INT64_MAX && INTPTR_MAX >= INT64_MAX
+#define DOUBLE_FITS_IN_INTPTR 1
+#else
+#define DOUBLE_FITS_IN_INTPTR 0
+#endif
+
 static void destroy_empty_constraint(Constraint *constraint);
 static int compare_want(Constraint *constraint, intptr_t comparison);
 static int compare_want_not(Constraint *constraint, intptr_t comparison);
@@ -25,8 +32,6 @@ static void test_want_string(Constraint *constraint, const char *function, intpt
 static int compare_want_double(Constraint *constraint, intptr_t comparison);
 static void test_want_double(Constraint *constraint, const char *function, intptr_t actual, const char *test_file, int test_line, TestReporter *reporter);
 static Constraint *create_constraint(const char *parameter);
-static void destroy_double_constraint(Constraint *constraint);
-static double unbox_double(intptr_t box);
 static double as_double(intptr_t box);
 
 void destroy_constraint(void *abstract) {
@@ -94,13 +99,12 @@ static void test_non_null(Constraint *constraint, const char *function, intptr_t
 }
 
 Constraint *want_double_(const char *parameter, intptr_t expected) {
-    Constraint *constraint = (Constraint *)malloc(sizeof(Constraint));
-    constraint->parameter = parameter;
-    constraint->destroy = &destroy_double_constraint;
+    Constraint *constraint = create_constraint(parameter);
     constraint->parameter = parameter;
     constraint->compare = &compare_want_double;
     constraint->test = &test_want_double;
     constraint->expected = expected;
+    constraint->expected_double = as_double(expected);
 	constraint->out_value = 0;
 	constraint->copy_size = 0;
 	constraint->constraint_type = CG_CONSTRAINT_WANT;
@@ -134,13 +138,20 @@ Constraint *fill_(const char *parameter, intptr_t out_value, int size)
 }
 
 intptr_t box_double(double d) {
-    BoxedDouble *box = (BoxedDouble *) malloc(sizeof(BoxedDouble));
+#if DOUBLE_FITS_IN_INTPTR
+    intptr_t bits;
+    memcpy(&bits, &d, sizeof(double));
+    return bits;
+#else
+    BoxedDouble *box = (BoxedDouble *)allocate_test_memory(sizeof(BoxedDouble));
     box->d = d;
     return (intptr_t)box;
+#endif
 }
 
+/* Constraints live in the test memory, and go when the test does */
 static void destroy_empty_constraint(Constraint *constraint) {
-    free(constraint);
+    (void) constraint;
 }
 
 static int compare_want(Constraint *constraint, intptr_t comparison) {
@@ -195,7 +206,7 @@ static void test_want_string(Constraint *constraint, const char *function, intpt
 }
 
 static int compare_want_double(Constraint *constraint, intptr_t comparison) {
-    return doubles_are_equal(as_double(constraint->expected), as_double(comparison));
+    return doubles_are_equal(constraint->expected_double, as_double(comparison));
 }
 
 static void test_want_double(Constraint *constraint, const char *function, intptr_t actual, const char *test_file, int test_line, TestReporter *reporter) {
@@ -204,34 +215,29 @@ static void test_want_double(Constraint *constraint, const char *function, intpt
             test_file,
             test_line,
             (*constraint->compare)(constraint, actual),
-            "Wanted [%d], but got [%d] in function [%s] parameter [%s]",
-            as_double(constraint->expected),
+            "Wanted [%f], but got [%f] in function [%s] parameter [%s]",
+            constraint->expected_double,
             as_double(actual),
             function,
             constraint->parameter);
-    unbox_double(actual);
 }
 
 static Constraint *create_constraint(const char *parameter) {
-    Constraint *constraint = (Constraint *)malloc(sizeof(Constraint));
+    Constraint *constraint = (Constraint *)allocate_test_memory(sizeof(Constraint));
     constraint->parameter = parameter;
     constraint->destroy = &destroy_empty_constraint;
+    constraint->expected_double = 0;
     return constraint;
 }
 
-static void destroy_double_constraint(Constraint *constraint) {
-    unbox_double(constraint->expected);
-    destroy_empty_constraint(constraint);
-}
-
-static double unbox_double(intptr_t box) {
-    double d = as_double(box);
-    free((BoxedDouble *)box);
-    return d;
-}
-
 static double as_double(intptr_t box) {
+#if DOUBLE_FITS_IN_INTPTR
+    double d;
+    memcpy(&d, &box, sizeof(double));
+    return d;
+#else
     return ((BoxedDouble *)box)->d;
+#endif
 }
 
 /* vim: set ts=4 sw=4 et cindent: */
@@ -1,6 +1,7 @@
 #include <cgreen/cute_reporter.h>
 #include <cgreen/reporter.h>
 #include <cgreen/breadcrumb.h>
+#include <cgreen/reporter_output.h>
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -17,6 +18,7 @@ static void assert_passed(TestReporter *reporter, const char *file, int line, co
 static void testcase_failed_to_complete(TestReporter *reporter, const char *name);
 static void cute_reporter_testcase_finished(TestReporter *reporter, const char *name);
 static void cute_reporter_suite_finished(TestReporter *reporter, const char *name);
+static void event_done(CuteMemo *memo);
 
 
 void set_cute_printer(TestReporter *reporter, Printer *printer) {
@@ -38,7 +40,7 @@ TestReporter *create_cute_reporter(void) {
         destroy_reporter(reporter);
         return NULL;
     }
-	memo->printer = printf;
+	memo->printer = standard_output_printf;
 
 	reporter->start_suite = &cute_reporter_suite_started;
 	reporter->start_test = &cute_reporter_testcase_started;
@@ -58,6 +60,7 @@ static void cute_reporter_suite_started(TestReporter *reporter, const char *name
 	CuteMemo *memo = (CuteMemo *)reporter->memo;
 	reporter_start(reporter, name);
 	memo->printer("#beginning %s %d\n", name, number_of_tests);
+	event_done(memo);
 }
 
 static void cute_reporter_testcase_started(TestReporter *reporter, const char *name) {
@@ -66,6 +69,7 @@ static void cute_reporter_testcase_started(TestReporter *reporter, const char *n
 	memo->previous_error = 0;
 	reporter_start(reporter, name);
 	memo->printer("#starting %s\n", name);
+	event_done(memo);
 }
 
 static void cute_reporter_testcase_finished(TestReporter *reporter, const char *name) {
@@ -74,6 +78,7 @@ static void cute_reporter_testcase_finished(TestReporter *reporter, const char *
 	if (memo->error_count == reporter->failures + reporter->exceptions) {
 		memo->printer("#success %s OK\n", name);
 	}
+	event_done(memo);
 }
 
 static void cute_reporter_suite_finished(TestReporter *reporter, const char *name) {
@@ -90,6 +95,7 @@ static void cute_reporter_suite_finished(TestReporter *reporter, const char *nam
 				reporter->exceptions == 1 ? "" : "s");
 	} else
 		memo->printer("\n");
+	event_done(memo);
 }
 
 static void assert_failed(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments) {
@@ -102,6 +108,7 @@ static void assert_failed(TestReporter *reporter, const char *file, int line, co
 		memo->printer("%s\n", buffer);
 		memo->previous_error = 1;
 	}
+	event_done(memo);
 }
 
 static void assert_passed(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments) {
@@ -110,6 +117,14 @@ static void assert_passed(TestReporter *reporter, const char *file, int line, co
 static void testcase_failed_to_complete(TestReporter *reporter, const char *name) {
 	CuteMemo *memo = (CuteMemo *)reporter->memo;
     memo->printer("#error %s failed to complete\n", name);
+    event_done(memo);
+}
+
+/* A printer of the caller's own is left to do its own flushing */
+static void event_done(CuteMemo *memo) {
+	if (memo->printer == standard_output_printf) {
+		reporter_output_event_done(standard_reporter_output());
+	}
 }
 
 /* vim: set ts=4 sw=4 et cindent: */
@@ -0,0 +1,523 @@
+#include <cgreen/event_log_reporter.h>
+#include <cgreen/reporter.h>
+#include <cgreen/breadcrumb.h>
+#include "reporter_helpers.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#if defined WINCE || defined WIN32
+#include <io.h>
+#include <cgreen/reporter_output.h>
+#else
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#endif
+
+/* The log starts with a preamble and then holds one record per event.
+   Each record is a fixed header followed by the event's texts, each
+   ending in a nul, and is padded to a multiple of eight bytes. A test
+   that was measured carries its metrics between the header and the
+   texts of the event that finishes it. */
+#define EVENT_LOG_MAGIC "CGREENEV"
+#define EVENT_LOG_VERSION 1
+#define FIRST_MAPPING_SIZE (1024 * 1024)
+
+enum {
+    suite_started_event = 1,
+    suite_finished_event,
+    test_started_event,
+    test_finished_event,
+    failure_event,
+    incomplete_event
+};
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+} EventLogPreamble;
+
+typedef struct {
+    uint32_t size;
+    uint16_t type;
+    uint16_t texts;
+    int64_t time;
+    int64_t values[2];
+} EventRecord;
+
+/* Times in nanoseconds, the counts as they come */
+typedef struct {
+    int64_t wall_time;
+    int64_t user_time;
+    int64_t system_time;
+    int64_t max_resident_kb;
+    int64_t minor_faults;
+    int64_t major_faults;
+    int64_t voluntary_switches;
+    int64_t involuntary_switches;
+} MetricsPayload;
+
+/* Test processes are forked with the log already mapped, so only the
+   process that created it may write to it */
+typedef struct EventLogMemo_ {
+    int file_descriptor;
+#if defined WINCE || defined WIN32
+    ReporterOutput *output;
+#else
+    char *mapping;
+    size_t mapped;
+    int forked;
+    struct EventLogMemo_ *next;
+#endif
+    size_t used;
+    int measured;
+    MetricsPayload metrics;
+} EventLogMemo;
+
+#if !defined WINCE && !defined WIN32
+static EventLogMemo *logs = NULL;
+static int fork_handler_installed = 0;
+#endif
+
+static void destroy_event_log_reporter(TestReporter *reporter);
+static void event_log_suite_started(TestReporter *reporter, const char *name, const int number_of_tests);
+static void event_log_test_started(TestReporter *reporter, const char *name);
+static void show_failed(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments);
+static void show_incomplete(TestReporter *reporter, const char *name);
+static void record_metrics(TestReporter *reporter, const char *name, const TestMetrics *metrics);
+static void event_log_test_finished(TestReporter *reporter, const char *name);
+static void event_log_suite_finished(TestReporter *reporter, const char *name);
+static void log_event(EventLogMemo *memo, int type, int64_t first_value, int64_t second_value,
+                      const void *payload, size_t payload_size, const char *first_text, const char *second_text);
+static int is_owner(EventLogMemo *memo);
+#if !defined WINCE && !defined WIN32
+static void forget_logs_in_child();
+#endif
+static char *reserve(EventLogMemo *memo, size_t size);
+static void commit(EventLogMemo *memo, char *record, size_t size);
+static char *read_whole_file(const char *path, size_t *size);
+static int is_event_log(const char *log, size_t size);
+static const char *next_text(const char **text, const char *end);
+static void replay_passes(TestReporter *reporter, int64_t passes);
+static void replay_failure(TestReporter *reporter, const char *file, int line, const char *text);
+
+TestReporter *create_event_log_reporter(const char *path) {
+    TestReporter *reporter;
+    EventLogMemo *memo;
+    EventLogPreamble preamble;
+    char *start;
+
+    if (path == NULL) {
+        return NULL;
+    }
+    reporter = create_reporter();
+    if (reporter == NULL) {
+        return NULL;
+    }
+    memo = (EventLogMemo *)malloc(sizeof(EventLogMemo));
+    if (memo == NULL) {
+        destroy_reporter(reporter);
+        return NULL;
+    }
+    memo->used = 0;
+    memo->measured = 0;
+#if defined WINCE || defined WIN32
+    memo->file_descriptor = _open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+    memo->output = NULL;
+    if (memo->file_descriptor >= 0) {
+        memo->output = create_reporter_output(memo->file_descriptor);
+    }
+    if (memo->output == NULL) {
+        if (memo->file_descriptor >= 0) {
+            _close(memo->file_descriptor);
+        }
+        free(memo);
+        destroy_reporter(reporter);
+        return NULL;
+    }
+#else
+    memo->file_descriptor = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    memo->mapping = NULL;
+    memo->mapped = 0;
+    memo->forked = 0;
+    if (memo->file_descriptor < 0) {
+        free(memo);
+        destroy_reporter(reporter);
+        return NULL;
+    }
+    if (! fork_handler_installed) {
+        pthread_atfork(NULL, NULL, &forget_logs_in_child);
+        fork_handler_installed = 1;
+    }
+    memo->next = logs;
+    logs = memo;
+#endif
+    reporter->memo = memo;
+    memset(&preamble, 0, sizeof(preamble));
+    memcpy(preamble.magic, EVENT_LOG_MAGIC, sizeof(preamble.magic));
+    preamble.version = EVENT_LOG_VERSION;
+    preamble.record_size = sizeof(EventRecord);
+    start = reserve(memo, sizeof(preamble));
+    if (start == NULL) {
+        memo->used = 0;
+        destroy_event_log_reporter(reporter);
+        return NULL;
+    }
+    memcpy(start, &preamble, sizeof(preamble));
+    commit(memo, start, sizeof(preamble));
+
+    reporter->destroy = &destroy_event_log_reporter;
+    reporter->start_suite = &event_log_suite_started;
+    reporter->start_test = &event_log_test_started;
+    reporter->show_fail = &show_failed;
+    reporter->show_incomplete = &show_incomplete;
+    reporter->record_metrics = &record_metrics;
+    reporter->finish_test = &event_log_test_finished;
+    reporter->finish_suite = &event_log_suite_finished;
+    return reporter;
+}
+
+/* Until here the file has zeroes after the last event, which is where a
+   reader stops when the run was killed */
+static void destroy_event_log_reporter(TestReporter *reporter) {
+    EventLogMemo *memo = (EventLogMemo *)reporter->memo;
+#if !defined WINCE && !defined WIN32
+    EventLogMemo **link;
+#endif
+    if (memo == NULL) {
+        destroy_reporter(reporter);
+        return;
+    }
+#if defined WINCE || defined WIN32
+    destroy_reporter_output(memo->output);
+    _close(memo->file_descriptor);
+#else
+    for (link = &logs; *link != NULL; link = &(*link)->next) {
+        if (*link == memo) {
+            *link = memo->next;
+            break;
+        }
+    }
+    if (memo->mapping != NULL) {
+        munmap(memo->mapping, memo->mapped);
+    }
+    if (is_owner(memo) && ftruncate(memo->file_descriptor, memo->used) != 0) {
+        memo->used = 0;
+    }
+    close(memo->file_descriptor);
+#endif
+    free(memo);
+    reporter->memo = NULL;
+    destroy_reporter(reporter);
+}
+
+static void event_log_suite_started(TestReporter *reporter, const char *name, const int number_of_tests) {
+    log_event((EventLogMemo *)reporter->memo, suite_started_event, number_of_tests, 0, NULL, 0, name, NULL);
+    reporter_start(reporter, name);
+}
+
+static void event_log_test_started(TestReporter *reporter, const char *name) {
+    log_event((EventLogMemo *)reporter->memo, test_started_event, 0, 0, NULL, 0, name, NULL);
+    reporter_start(reporter, name);
+}
+
+/* Only failures are formatted. Passes are counted by the runner and go
+   into the log as a total when the test finishes. */
+static void show_failed(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments) {
+    char *text = (message == NULL ? NULL : format_reporter_message(message, arguments));
+    log_event((EventLogMemo *)reporter->memo, failure_event, line, text != NULL, NULL, 0,
+              file == NULL ? "" : file, text);
+    free(text);
+}
+
+static void show_incomplete(TestReporter *reporter, const char *name) {
+    log_event((EventLogMemo *)reporter->memo, incomplete_event, 0, 0, NULL, 0, name, NULL);
+}
+
+static void record_metrics(TestReporter *reporter, const char *name, const TestMetrics *metrics) {
+    EventLogMemo *memo = (EventLogMemo *)reporter->memo;
+    (void) name;
+    memo->metrics.wall_time = (int64_t)(metrics->wall_time * 1e9);
+    memo->metrics.user_time = (int64_t)(metrics->user_time * 1e9);
+    memo->metrics.system_time = (int64_t)(metrics->system_time * 1e9);
+    memo->metrics.max_resident_kb = metrics->max_resident_kb;
+    memo->metrics.minor_faults = metrics->minor_faults;
+    memo->metrics.major_faults = metrics->major_faults;
+    memo->metrics.voluntary_switches = metrics->voluntary_switches;
+    memo->metrics.involuntary_switches = metrics->involuntary_switches;
+    memo->measured = 1;
+}
+
+static void event_log_test_finished(TestReporter *reporter, const char *name) {
+    EventLogMemo *memo = (EventLogMemo *)reporter->memo;
+    int passes = reporter->passes;
+    reporter_finish(reporter, name);
+    log_event(memo, test_finished_event, reporter->passes - passes, memo->measured,
+              &memo->metrics, memo->measured ? sizeof(memo->metrics) : 0, name, NULL);
+    memo->measured = 0;
+}
+
+static void event_log_suite_finished(TestReporter *reporter, const char *name) {
+    EventLogMemo *memo = (EventLogMemo *)reporter->memo;
+    int passes = reporter->passes;
+    reporter_finish(reporter, name);
+    log_event(memo, suite_finished_event, reporter->passes - passes, 0, NULL, 0, name, NULL);
+#if defined WINCE || defined WIN32
+    if (get_breadcrumb_depth((CgreenBreadcrumb *)reporter->breadcrumb) == 0) {
+        flush_reporter_output(memo->output);
+    }
+#endif
+}
+
+int replay_event_log(const char *path, TestReporter *reporter) {
+    TestMetrics metrics;
+    MetricsPayload payload;
+    const EventRecord *record;
+    const char *text;
+    const char *end;
+    const char *first;
+    const char *second;
+    char *log;
+    size_t size;
+    size_t offset;
+    int completed = 1;
+    int success;
+
+    if (reporter == NULL) {
+        return EXIT_FAILURE;
+    }
+    log = read_whole_file(path, &size);
+    if (! is_event_log(log, size)) {
+        free(log);
+        (*reporter->destroy)(reporter);
+        return EXIT_FAILURE;
+    }
+    if (setup_reporting(reporter) < 0) {
+        free(log);
+        (*reporter->destroy)(reporter);
+        return EXIT_FAILURE;
+    }
+    for (offset = sizeof(EventLogPreamble); offset + sizeof(EventRecord) <= size; offset += record->size) {
+        record = (const EventRecord *)(log + offset);
+        if (record->size < sizeof(EventRecord) || record->size % 8 != 0 || record->size > size - offset) {
+            break;
+        }
+        text = (const char *)record + sizeof(EventRecord);
+        end = (const char *)record + record->size;
+        if (record->type == test_finished_event && record->values[1]) {
+            if (end - text < (long)sizeof(payload)) {
+                break;
+            }
+            memcpy(&payload, text, sizeof(payload));
+            text += sizeof(payload);
+        }
+        first = (record->texts > 0 ? next_text(&text, end) : NULL);
+        second = (record->texts > 1 ? next_text(&text, end) : NULL);
+        if ((record->texts > 0 && first == NULL) || (record->texts > 1 && second == NULL)) {
+            break;
+        }
+        switch (record->type) {
+        case suite_started_event:
+            (*reporter->start_suite)(reporter, first, (int)record->values[0]);
+            break;
+        case test_started_event:
+            (*reporter->start_test)(reporter, first);
+            completed = 1;
+            break;
+        case failure_event:
+            replay_failure(reporter, first, (int)record->values[0], record->values[1] ? second : NULL);
+            break;
+        case incomplete_event:
+            completed = 0;
+            break;
+        case test_finished_event:
+            replay_passes(reporter, record->values[0]);
+            if (completed) {
+                send_reporter_completion_notification(reporter);
+            }
+            if (record->values[1]) {
+                metrics.wall_time = payload.wall_time / 1e9;
+                metrics.user_time = payload.user_time / 1e9;
+                metrics.system_time = payload.system_time / 1e9;
+                metrics.max_resident_kb = (long)payload.max_resident_kb;
+                metrics.minor_faults = (long)payload.minor_faults;
+                metrics.major_faults = (long)payload.major_faults;
+                metrics.voluntary_switches = (long)payload.voluntary_switches;
+                metrics.involuntary_switches = (long)payload.involuntary_switches;
+                (*reporter->record_metrics)(reporter, first, &metrics);
+            }
+            (*reporter->finish_test)(reporter, first);
+            completed = 1;
+            break;
+        case suite_finished_event:
+            replay_passes(reporter, record->values[0]);
+            send_reporter_completion_notification(reporter);
+            (*reporter->finish_suite)(reporter, first);
+            break;
+        }
+    }
+    success = (reporter->failures == 0 && reporter->exceptions == 0);
+    (*reporter->destroy)(reporter);
+    free(log);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void log_event(EventLogMemo *memo, int type, int64_t first_value, int64_t second_value,
+                      const void *payload, size_t payload_size, const char *first_text, const char *second_text) {
+    size_t first_size = (first_text == NULL ? 0 : strlen(first_text) + 1);
+    size_t second_size = (second_text == NULL ? 0 : strlen(second_text) + 1);
+    size_t size = (sizeof(EventRecord) + payload_size + first_size + second_size + 7) & ~(size_t)7;
+    EventRecord header;
+    char *record;
+    if (! is_owner(memo)) {
+        return;
+    }
+    record = reserve(memo, size);
+    if (record == NULL) {
+        return;
+    }
+    header.size = 0;
+    header.type = (uint16_t)type;
+    header.texts = (uint16_t)((first_text != NULL) + (second_text != NULL));
+    header.time = wall_clock_nanoseconds_now();
+    header.values[0] = first_value;
+    header.values[1] = second_value;
+    memcpy(record, &header, sizeof(header));
+    if (payload_size > 0) {
+        memcpy(record + sizeof(header), payload, payload_size);
+    }
+    if (first_size > 0) {
+        memcpy(record + sizeof(header) + payload_size, first_text, first_size);
+    }
+    if (second_size > 0) {
+        memcpy(record + sizeof(header) + payload_size + first_size, second_text, second_size);
+    }
+    memset(record + sizeof(header) + payload_size + first_size + second_size, 0,
+           size - sizeof(header) - payload_size - first_size - second_size);
+    commit(memo, record, size);
+}
+
+#if defined WINCE || defined WIN32
+static int is_owner(EventLogMemo *memo) {
+    return 1;
+}
+
+static char *reserve(EventLogMemo *memo, size_t size) {
+    return (char *)malloc(size);
+}
+
+static void commit(EventLogMemo *memo, char *record, size_t size) {
+    if (size >= sizeof(EventRecord)) {
+        ((EventRecord *)record)->size = (uint32_t)size;
+    }
+    reporter_output_write(memo->output, record, size);
+    memo->used += size;
+    free(record);
+}
+#else
+static int is_owner(EventLogMemo *memo) {
+    return ! memo->forked;
+}
+
+static void forget_logs_in_child() {
+    EventLogMemo *log;
+    for (log = logs; log != NULL; log = log->next) {
+        log->forked = 1;
+    }
+}
+
+/* The file grows by doubling, and is mapped afresh each time */
+static char *reserve(EventLogMemo *memo, size_t size) {
+    size_t mapped = (memo->mapped == 0 ? FIRST_MAPPING_SIZE : memo->mapped);
+    char *mapping;
+    if (memo->used + size <= memo->mapped) {
+        return memo->mapping + memo->used;
+    }
+    while (mapped < memo->used + size) {
+        mapped *= 2;
+    }
+    if (ftruncate(memo->file_descriptor, mapped) != 0) {
+        return NULL;
+    }
+    mapping = (char *)mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, memo->file_descriptor, 0);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+    if (memo->mapping != NULL) {
+        munmap(memo->mapping, memo->mapped);
+    }
+    memo->mapping = mapping;
+    memo->mapped = mapped;
+    return memo->mapping + memo->used;
+}
+
+/* The size goes in last, so that a reader never sees half an event */
+static void commit(EventLogMemo *memo, char *record, size_t size) {
+    if (size >= sizeof(EventRecord)) {
+        __atomic_store_n(&((EventRecord *)record)->size, (uint32_t)size, __ATOMIC_RELEASE);
+    }
+    memo->used += size;
+}
+#endif
+
+static char *read_whole_file(const char *path, size_t *size) {
+    FILE *file = fopen(path, "rb");
+    char *contents;
+    long length;
+    if (file == NULL) {
+        return NULL;
+    }
+    if (fseek(file, 0, SEEK_END) != 0 || (length = ftell(file)) < 0) {
+        fclose(file);
+        return NULL;
+    }
+    rewind(file);
+    contents = (char *)malloc(length + 1);
+    if (contents == NULL) {
+        fclose(file);
+        return NULL;
+    }
+    *size = fread(contents, 1, length, file);
+    fclose(file);
+    return contents;
+}
+
+static int is_event_log(const char *log, size_t size) {
+    EventLogPreamble preamble;
+    if (log == NULL || size < sizeof(preamble)) {
+        return 0;
+    }
+    memcpy(&preamble, log, sizeof(preamble));
+    return memcmp(preamble.magic, EVENT_LOG_MAGIC, sizeof(preamble.magic)) == 0 &&
+           preamble.version == EVENT_LOG_VERSION &&
+           preamble.record_size == sizeof(EventRecord);
+}
+
+static const char *next_text(const char **text, const char *end) {
+    const char *start = *text;
+    const char *nul = (start < end ? (const char *)memchr(start, '\0', end - start) : NULL);
+    if (nul == NULL) {
+        return NULL;
+    }
+    *text = nul + 1;
+    return start;
+}
+
+static void replay_passes(TestReporter *reporter, int64_t passes) {
+    for (; passes > 0; passes--) {
+        add_reporter_result(reporter, 1);
+    }
+}
+
+static void replay_failure(TestReporter *reporter, const char *file, int line, const char *text) {
+    if (text == NULL) {
+        (*reporter->assert_true)(reporter, file, line, 0, NULL);
+    } else {
+        (*reporter->assert_true)(reporter, file, line, 0, "%s", text);
+    }
+}
+
+/* vim: set ts=4 sw=4 et cindent: */
@@ -0,0 +1,315 @@
+#include <cgreen/junit_reporter.h>
+#include <cgreen/reporter.h>
+#include <cgreen/reporter_output.h>
+#include <cgreen/breadcrumb.h>
+#include "reporter_helpers.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#if defined WINCE || defined WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+/* Each test case is written as soon as the test is over, so nothing is
+   kept for the whole document. The totals can only be known at the end,
+   so the opening tag leaves room for them to be written over. */
+#define XML_DECLARATION "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+#define SUITE_TAG "<testsuite"
+#define TOTALS_WIDTH 96
+#define SECONDS_BETWEEN_FLUSHES 0.1
+
+typedef struct {
+    ReporterOutput *output;
+    int file_descriptor;
+    int started;
+    int finished;
+    int tests;
+    int failed_tests;
+    int errors;
+    int in_test_case;
+    int test_case_has_body;
+    int test_case_failed;
+    int test_case_measured;
+    double test_case_time;
+    double run_started;
+    double test_started;
+    double last_flush;
+} JunitMemo;
+
+/* Counts down the breadcrumbs, so that the test's own name is left out */
+typedef struct {
+    ReporterOutput *output;
+    int suites;
+    int written;
+} ClassNameWalk;
+
+static void destroy_junit_reporter(TestReporter *reporter);
+static void junit_reporter_suite_started(TestReporter *reporter, const char *name, const int number_of_tests);
+static void junit_reporter_testcase_started(TestReporter *reporter, const char *name);
+static void show_failed(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments);
+static void show_incomplete(TestReporter *reporter, const char *name);
+static void record_metrics(TestReporter *reporter, const char *name, const TestMetrics *metrics);
+static void junit_reporter_testcase_finished(TestReporter *reporter, const char *name);
+static void junit_reporter_suite_finished(TestReporter *reporter, const char *name);
+static void open_test_case(TestReporter *reporter, JunitMemo *memo, const char *name, double seconds, int suites);
+static void start_test_case_body(JunitMemo *memo);
+static void close_test_case(JunitMemo *memo);
+static void write_class_name(const char *name, void *memo);
+static void write_totals(JunitMemo *memo);
+static void write_escaped(ReporterOutput *output, const char *text);
+static void write_to_output(void *output, const char *text, size_t size);
+
+TestReporter *create_junit_reporter(const char *path) {
+    TestReporter *reporter;
+    JunitMemo *memo;
+
+    if (path == NULL) {
+        return NULL;
+    }
+    reporter = create_reporter();
+    if (reporter == NULL) {
+        return NULL;
+    }
+    memo = (JunitMemo *)malloc(sizeof(JunitMemo));
+    if (memo == NULL) {
+        destroy_reporter(reporter);
+        return NULL;
+    }
+#if defined WINCE || defined WIN32
+    memo->file_descriptor = _open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+#else
+    memo->file_descriptor = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    if (memo->file_descriptor < 0) {
+        free(memo);
+        destroy_reporter(reporter);
+        return NULL;
+    }
+    memo->output = create_reporter_output(memo->file_descriptor);
+    if (memo->output == NULL) {
+#if defined WINCE || defined WIN32
+        _close(memo->file_descriptor);
+#else
+        close(memo->file_descriptor);
+#endif
+        free(memo);
+        destroy_reporter(reporter);
+        return NULL;
+    }
+    memo->started = 0;
+    memo->finished = 0;
+    memo->tests = 0;
+    memo->failed_tests = 0;
+    memo->errors = 0;
+    memo->in_test_case = 0;
+    memo->test_case_measured = 0;
+    memo->run_started = monotonic_seconds_now();
+    memo->test_started = memo->run_started;
+    memo->last_flush = memo->run_started;
+
+    reporter->destroy = &destroy_junit_reporter;
+    reporter->start_suite = &junit_reporter_suite_started;
+    reporter->start_test = &junit_reporter_testcase_started;
+    reporter->show_fail = &show_failed;
+    reporter->show_incomplete = &show_incomplete;
+    reporter->record_metrics = &record_metrics;
+    reporter->finish_test = &junit_reporter_testcase_finished;
+    reporter->finish_suite = &junit_reporter_suite_finished;
+    reporter->memo = memo;
+    return reporter;
+}
+
+static void destroy_junit_reporter(TestReporter *reporter) {
+    JunitMemo *memo = (JunitMemo *)reporter->memo;
+    if (memo->started && ! memo->finished) {
+        reporter_output_printf(memo->output, "</testsuite>\n");
+    }
+    destroy_reporter_output(memo->output);
+    if (memo->started) {
+        write_totals(memo);
+    }
+#if defined WINCE || defined WIN32
+    _close(memo->file_descriptor);
+#else
+    close(memo->file_descriptor);
+#endif
+    free(memo);
+    reporter->memo = NULL;
+    destroy_reporter(reporter);
+}
+
+static void junit_reporter_suite_started(TestReporter *reporter, const char *name, const int number_of_tests) {
+    JunitMemo *memo = (JunitMemo *)reporter->memo;
+    (void) number_of_tests;
+    if (! memo->started) {
+        memo->started = 1;
+        memo->run_started = monotonic_seconds_now();
+        reporter_output_printf(memo->output, "%s%s%*s name=\"", XML_DECLARATION, SUITE_TAG, TOTALS_WIDTH, "");
+        write_escaped(memo->output, name);
+        reporter_output_printf(memo->output, "\">\n");
+    }
+    reporter_start(reporter, name);
+}
+
+static void junit_reporter_testcase_started(TestReporter *reporter, const char *name) {
+    JunitMemo *memo = (JunitMemo *)reporter->memo;
+    memo->test_started = monotonic_seconds_now();
+    memo->test_case_measured = 0;
+    reporter_start(reporter, name);
+}
+
+/* A failure outside of any test, in a suite's own set up, say, is given
+   a test case of its own named after the suite */
+static void show_failed(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments) {
+    JunitMemo *memo = (JunitMemo *)reporter->memo;
+    char *text = format_reporter_message((message == NULL ? "Problem" : message), arguments);
+    int stray = ! memo->in_test_case;
+    if (stray) {
+        open_test_case(reporter, memo,
+                get_current_from_breadcrumb((CgreenBreadcrumb *)reporter->breadcrumb), 0.0,
+                get_breadcrumb_depth((CgreenBreadcrumb *)reporter->breadcrumb) - 1);
+    }
+    start_test_case_body(memo);
+    memo->test_case_failed = 1;
+    reporter_output_printf(memo->output, "    <failure type=\"assertion\" message=\"");
+    write_escaped(memo->output, text == NULL ? "" : text);
+    reporter_output_printf(memo->output, "\">");
+    write_escaped(memo->output, file);
+    reporter_output_printf(memo->output, ":%d: ", line);
+    write_escaped(memo->output, text == NULL ? "" : text);
+    reporter_output_printf(memo->output, "</failure>\n");
+    free(text);
+    if (stray) {
+        close_test_case(memo);
+    }
+}
+
+static void show_incomplete(TestReporter *reporter, const char *name) {
+    JunitMemo *memo = (JunitMemo *)reporter->memo;
+    int stray = ! memo->in_test_case;
+    if (stray) {
+        open_test_case(reporter, memo, name, 0.0,
+                get_breadcrumb_depth((CgreenBreadcrumb *)reporter->breadcrumb) - 1);
+    }
+    start_test_case_body(memo);
+    memo->errors++;
+    reporter_output_printf(memo->output, "    <error type=\"exception\" message=\"Test failed to complete\"/>\n");
+    if (stray) {
+        close_test_case(memo);
+    }
+}
+
+/* The runner's own timing is the better one, as with parallel jobs the
+   test is reported well after it ran */
+static void record_metrics(TestReporter *reporter, const char *name, const TestMetrics *metrics) {
+    JunitMemo *memo = (JunitMemo *)reporter->memo;
+    (void) name;
+    memo->test_case_time = metrics->wall_time;
+    memo->test_case_measured = 1;
+}
+
+/* The results are only read in reporter_finish(), so the test case is
+   opened first for them to be written into */
+static void junit_reporter_testcase_finished(TestReporter *reporter, const char *name) {
+    JunitMemo *memo = (JunitMemo *)reporter->memo;
+    double now = monotonic_seconds_now();
+    double seconds = memo->test_case_measured ? memo->test_case_time : now - memo->test_started;
+    open_test_case(reporter, memo, name, seconds,
+            get_breadcrumb_depth((CgreenBreadcrumb *)reporter->breadcrumb) - 1);
+    reporter_finish(reporter, name);
+    close_test_case(memo);
+    memo->test_case_measured = 0;
+    if (now - memo->last_flush >= SECONDS_BETWEEN_FLUSHES) {
+        flush_reporter_output(memo->output);
+        memo->last_flush = now;
+    }
+}
+
+static void junit_reporter_suite_finished(TestReporter *reporter, const char *name) {
+    JunitMemo *memo = (JunitMemo *)reporter->memo;
+    reporter_finish(reporter, name);
+    if (memo->started && ! memo->finished &&
+            get_breadcrumb_depth((CgreenBreadcrumb *)reporter->breadcrumb) == 0) {
+        memo->finished = 1;
+        reporter_output_printf(memo->output, "</testsuite>\n");
+        flush_reporter_output(memo->output);
+        write_totals(memo);
+    }
+}
+
+static void open_test_case(TestReporter *reporter, JunitMemo *memo, const char *name, double seconds, int suites) {
+    ClassNameWalk walk = {memo->output, suites, 0};
+    reporter_output_printf(memo->output, "  <testcase classname=\"");
+    walk_breadcrumb((CgreenBreadcrumb *)reporter->breadcrumb, &write_class_name, &walk);
+    reporter_output_printf(memo->output, "\" name=\"");
+    write_escaped(memo->output, name);
+    reporter_output_printf(memo->output, "\" time=\"%.6f\"", seconds);
+    memo->in_test_case = 1;
+    memo->test_case_has_body = 0;
+    memo->test_case_failed = 0;
+    memo->tests++;
+}
+
+static void start_test_case_body(JunitMemo *memo) {
+    if (! memo->test_case_has_body) {
+        reporter_output_printf(memo->output, ">\n");
+        memo->test_case_has_body = 1;
+    }
+}
+
+static void close_test_case(JunitMemo *memo) {
+    if (memo->test_case_has_body) {
+        reporter_output_printf(memo->output, "  </testcase>\n");
+    } else {
+        reporter_output_printf(memo->output, "/>\n");
+    }
+    if (memo->test_case_failed) {
+        memo->failed_tests++;
+    }
+    memo->in_test_case = 0;
+}
+
+static void write_class_name(const char *name, void *memo) {
+    ClassNameWalk *walk = (ClassNameWalk *)memo;
+    if (walk->written < walk->suites) {
+        if (walk->written > 0) {
+            reporter_output_write(walk->output, ".", 1);
+        }
+        write_escaped(walk->output, name);
+        walk->written++;
+    }
+}
+
+/* A pipe cannot be written over, and then the totals stay at zero */
+static void write_totals(JunitMemo *memo) {
+    char totals[TOTALS_WIDTH + 1];
+    long offset = (long)(strlen(XML_DECLARATION) + strlen(SUITE_TAG));
+    int size = snprintf(totals, sizeof(totals), " tests=\"%d\" failures=\"%d\" errors=\"%d\" time=\"%.6f\"",
+            memo->tests, memo->failed_tests, memo->errors, monotonic_seconds_now() - memo->run_started);
+    if (size < 0 || size > TOTALS_WIDTH) {
+        return;
+    }
+#if defined WINCE || defined WIN32
+    if (_lseek(memo->file_descriptor, offset, SEEK_SET) == offset) {
+        _write(memo->file_descriptor, totals, size);
+        _lseek(memo->file_descriptor, 0, SEEK_END);
+    }
+#else
+    if (pwrite(memo->file_descriptor, totals, size, offset) != size) {
+        return;
+    }
+#endif
+}
+
+static void write_escaped(ReporterOutput *output, const char *text) {
+    write_xml_escaped(&write_to_output, output, text);
+}
+
+static void write_to_output(void *output, const char *text, size_t size) {
+    reporter_output_write((ReporterOutput *)output, text, size);
+}
+
+/* vim: set ts=4 sw=4 et cindent: */
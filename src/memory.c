@@ -1,77 +1,182 @@
 #include <stdlib.h>
 #include <string.h>
 #include <cgreen/memory.h>
+#if !defined WINCE && !defined WIN32
+#include <pthread.h>
+#endif
 
-#define MEMORY_INCREMENT 1024
+#define MEMORY_INCREMENT 8192
+
+/* Every allocation is rounded up to a multiple of this, so that
+   whatever is stored in it is suitably aligned. */
+typedef union {
+    void *pointer;
+    long integer;
+    double real;
+    long double extended;
+    void (*function)();
+} MemoryAlignment;
+
+#define ALIGNED(bytes) (((bytes) + sizeof(MemoryAlignment) - 1) / sizeof(MemoryAlignment) * sizeof(MemoryAlignment))
+
+/* Allocations are carved from the newest block in turn, each behind a
+   header holding its size so that it can be copied when it grows. */
+typedef struct MemoryBlock_ {
+    struct MemoryBlock_ *older;
+    size_t size;
+} MemoryBlock;
+
+#define BLOCK_HEADER ALIGNED(sizeof(MemoryBlock))
+#define ALLOCATION_HEADER ALIGNED(sizeof(size_t))
 
 struct MemoryPool_ {
-    void** blocks;
-    long size;
-    long space;
+    MemoryBlock *blocks;
+    char *next;
+    char *end;
+    void *last;
 };
 
-static void enlarge(MemoryPool *pool);
-static int move_to_front(MemoryPool *pool, void *pointer);
-static void move_up_one(void **blocks, long amount);
+static MemoryBlock *add_block(MemoryPool *pool, size_t bytes);
+static size_t *allocation_size(void *pointer);
 
 MemoryPool *create_memory_pool() {
     MemoryPool *pool = (MemoryPool *)malloc(sizeof(MemoryPool));
     if (pool == NULL) {
         return NULL;
     }
-    pool->blocks = (void **)malloc(MEMORY_INCREMENT * sizeof(void *));
-    if (pool->blocks == NULL) {
-        free(pool);
-        return NULL;
-    }
-    pool->size = 0;
-    pool->space = MEMORY_INCREMENT;
+    pool->blocks = NULL;
+    pool->next = NULL;
+    pool->end = NULL;
+    pool->last = NULL;
     return pool;
 }
 
 void free_memory_pool(MemoryPool *pool) {
-    long i;
-    for (i = 0; i < pool->size; i++) {
-        free(pool->blocks[i]);
+    while (pool->blocks != NULL) {
+        MemoryBlock *block = pool->blocks;
+        pool->blocks = block->older;
+        free(block);
     }
-    free(pool->blocks);
     free(pool);
 }
 
+/* Keeps the first block to be used again, frees the rest */
+void empty_memory_pool(MemoryPool *pool) {
+    MemoryBlock *block = pool->blocks;
+    if (block == NULL) {
+        return;
+    }
+    while (block->older != NULL) {
+        MemoryBlock *newer = block;
+        block = block->older;
+        free(newer);
+    }
+    pool->blocks = block;
+    pool->next = (char *)block + BLOCK_HEADER;
+    pool->end = (char *)block + block->size;
+    pool->last = NULL;
+}
+
 void *memory_pool_allocate(MemoryPool *pool, size_t bytes) {
-    enlarge(pool);
-    return pool->blocks[pool->size++] = malloc(bytes);
+    size_t needed = ALLOCATION_HEADER + ALIGNED(bytes);
+    void *pointer;
+    if (pool->next == NULL || (size_t)(pool->end - pool->next) < needed) {
+        if (add_block(pool, needed) == NULL) {
+            return NULL;
+        }
+    }
+    pointer = pool->next + ALLOCATION_HEADER;
+    *allocation_size(pointer) = bytes;
+    pool->next += needed;
+    pool->last = pointer;
+    return pointer;
 }
 
+/* The latest allocation grows in place while its block has room */
 void *memory_pool_reallocate(MemoryPool *pool, void *pointer, size_t bytes) {
-    if (! move_to_front(pool, pointer)) {
+    size_t size;
+    void *moved;
+    if (pointer == NULL) {
+        return memory_pool_allocate(pool, bytes);
+    }
+    size = *allocation_size(pointer);
+    if (pointer == pool->last &&
+            (size_t)(pool->end - (char *)pointer) >= ALIGNED(bytes)) {
+        pool->next = (char *)pointer + ALIGNED(bytes);
+        *allocation_size(pointer) = bytes;
+        return pointer;
+    }
+    moved = memory_pool_allocate(pool, bytes);
+    if (moved != NULL) {
+        memcpy(moved, pointer, size < bytes ? size : bytes);
+    }
+    return moved;
+}
+
+static MemoryBlock *add_block(MemoryPool *pool, size_t bytes) {
+    size_t size = BLOCK_HEADER + bytes;
+    MemoryBlock *block;
+    if (size < MEMORY_INCREMENT) {
+        size = MEMORY_INCREMENT;
+    }
+    block = (MemoryBlock *)malloc(size);
+    if (block == NULL) {
         return NULL;
     }
-    return pool->blocks[0] = realloc(pool->blocks[0], bytes);
+    block->older = pool->blocks;
+    block->size = size;
+    pool->blocks = block;
+    pool->next = (char *)block + BLOCK_HEADER;
+    pool->end = (char *)block + size;
+    return block;
 }
 
-static void enlarge(MemoryPool *pool) {
-    if (pool->size == pool->space) {
-        pool->blocks = realloc(pool->blocks, (pool->space + MEMORY_INCREMENT) * sizeof(void *));
-        pool->space += MEMORY_INCREMENT;
+static size_t *allocation_size(void *pointer) {
+    return (size_t *)((char *)pointer - ALLOCATION_HEADER);
+}
+
+/* Mocks may be called from threads of the code under test, so the
+   test memory is shared between them under a lock. */
+static MemoryPool *test_memory = NULL;
+#if defined WINCE || defined WIN32
+#define LOCK_TEST_MEMORY()
+#define UNLOCK_TEST_MEMORY()
+#else
+static pthread_mutex_t test_memory_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_TEST_MEMORY() pthread_mutex_lock(&test_memory_lock)
+#define UNLOCK_TEST_MEMORY() pthread_mutex_unlock(&test_memory_lock)
+#endif
+
+void *allocate_test_memory(size_t bytes) {
+    void *pointer = NULL;
+    LOCK_TEST_MEMORY();
+    if (test_memory == NULL) {
+        test_memory = create_memory_pool();
+    }
+    if (test_memory != NULL) {
+        pointer = memory_pool_allocate(test_memory, bytes);
     }
+    UNLOCK_TEST_MEMORY();
+    return pointer;
 }
 
-static int move_to_front(MemoryPool *pool, void *pointer) {
-    long i;
-    for (i = 1; i < pool->size; i++) {
-        if (pool->blocks[i] == pointer) {
-            move_up_one(pool->blocks, i);
-            pool->blocks[0] = pointer;
-            return 1;
-        }
+void *reallocate_test_memory(void *pointer, size_t bytes) {
+    void *moved = NULL;
+    LOCK_TEST_MEMORY();
+    if (test_memory == NULL) {
+        test_memory = create_memory_pool();
+    }
+    if (test_memory != NULL) {
+        moved = memory_pool_reallocate(test_memory, pointer, bytes);
     }
-    return 0;
+    UNLOCK_TEST_MEMORY();
+    return moved;
 }
 
-static void move_up_one(void **blocks, long amount) {
-    if (amount == 0) {
-        return;
+void free_test_memory() {
+    LOCK_TEST_MEMORY();
+    if (test_memory != NULL) {
+        empty_memory_pool(test_memory);
     }
-    memmove(blocks[0], blocks[1], blocks[amount] - blocks[1]);
+    UNLOCK_TEST_MEMORY();
 }
@@ -9,8 +9,9 @@
 #include <fcntl.h>
 #include <unistd.h>
 #else
+#include <stdio.h>
 #include <unistd.h>
-#include <sys/msg.h>
+#include <sys/mman.h>
 #endif
 
 #include <stdlib.h>
@@ -19,6 +20,23 @@
 
 #define message_content_size(Type) (sizeof(Type) - sizeof(long))
 
+#if !defined WINCE && !defined WIN32 && !defined ANDROID && !defined IPHONE
+#define RING_SIZE 65536
+
+/* Shared between the runner and every process it forks. Only one of
+   them writes at a time, and only the runner reads, so the indices need
+   no lock. If the runner falls behind, results go to the spill file
+   until it has caught up with both. */
+typedef struct CgreenRing_ {
+    volatile unsigned int head;
+    volatile unsigned int tail;
+    volatile int overflowed;
+    volatile long spilled;
+    volatile long drained;
+    int records[RING_SIZE];
+} CgreenRing;
+#endif
+
 typedef struct CgreenMessageQueue_ {
 #if defined WINCE || defined WIN32
     FILE* pReadQueue;
@@ -27,7 +45,8 @@ typedef struct CgreenMessageQueue_ {
 #elif defined(ANDROID) || defined(IPHONE)
 	int fd[2];
 #else
-    int queue;
+    CgreenRing *ring;
+    FILE *spill;
     pid_t owner;
 #endif
     int tag;
@@ -42,6 +61,15 @@ static CgreenMessageQueue *queues = NULL;
 static int queue_count = 0;
 
 static void clean_up_messaging(void);
+static void send_records(int messaging, const int *records, int count);
+static int receive_record(int messaging);
+#if defined WINCE || defined WIN32 || defined ANDROID || defined IPHONE
+static void send_record(int messaging, int result);
+#endif
+#if !defined WINCE && !defined WIN32 && !defined ANDROID && !defined IPHONE
+static void write_to_ring(CgreenMessageQueue *queue, const int *records, int count);
+static int read_from_ring(CgreenMessageQueue *queue);
+#endif
 
 int start_cgreen_messaging(int tag) {
 #if defined WINCE
@@ -103,19 +131,27 @@ int start_cgreen_messaging(int tag) {
 	return queue_count - 1;
 #else
     CgreenMessageQueue *tmp;
+    void *ring;
     if (queue_count == 0) {
         atexit(&clean_up_messaging);
     }
-    tmp = realloc(queues, sizeof(CgreenMessageQueue) * ++queue_count);
+    ring = mmap(NULL, sizeof(CgreenRing), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) {
+        return -1;
+    }
+    tmp = realloc(queues, sizeof(CgreenMessageQueue) * (queue_count + 1));
     if (tmp == NULL) {
-      atexit(&clean_up_messaging);
-      return -1;
+        munmap(ring, sizeof(CgreenRing));
+        return -1;
     }
     queues = tmp;
-    queues[queue_count - 1].queue = msgget((long)getpid(), 0666 | IPC_CREAT);
-    if (queues[queue_count - 1].queue == -1) {
+    queues[queue_count].ring = (CgreenRing *)ring;
+    queues[queue_count].spill = tmpfile();
+    if (queues[queue_count].spill == NULL) {
+        munmap(ring, sizeof(CgreenRing));
         return -1;
     }
+    queue_count++;
     queues[queue_count - 1].owner = getpid();
     queues[queue_count - 1].tag = tag;
     return queue_count - 1;
@@ -123,6 +159,75 @@ int start_cgreen_messaging(int tag) {
 }
 
 void send_cgreen_message(int messaging, int result) {
+    send_records(messaging, &result, 1);
+}
+
+/* The payload goes first, as its negated size and then the bytes packed
+   into records, so that a reader never confuses it with a result. */
+void send_cgreen_message_with_payload(int messaging, int result, const void *payload, size_t size) {
+    int count = 2 + (int)((size + sizeof(int) - 1) / sizeof(int));
+    int *records;
+    if (size == 0) {
+        send_cgreen_message(messaging, result);
+        return;
+    }
+    records = (int *)calloc(count, sizeof(int));
+    if (records == NULL) {
+        send_cgreen_message(messaging, result);
+        return;
+    }
+    records[0] = -(int)size;
+    memcpy(records + 1, payload, size);
+    records[count - 1] = result;
+    send_records(messaging, records, count);
+    free(records);
+}
+
+int receive_cgreen_message(int messaging) {
+    return receive_cgreen_message_with_payload(messaging, NULL, NULL);
+}
+
+int receive_cgreen_message_with_payload(int messaging, void **payload, size_t *size) {
+    int result = receive_record(messaging);
+    int *records = NULL;
+    int count, i;
+    if (payload != NULL) {
+        *payload = NULL;
+        *size = 0;
+    }
+    if (result >= 0) {
+        return result;
+    }
+    count = (int)((-result + sizeof(int) - 1) / sizeof(int));
+    if (payload != NULL) {
+        records = (int *)malloc(count * sizeof(int));
+    }
+    for (i = 0; i < count; i++) {
+        int record = receive_record(messaging);
+        if (records != NULL) {
+            records[i] = record;
+        }
+    }
+    if (records != NULL) {
+        *payload = records;
+        *size = (size_t)-result;
+    }
+    return receive_record(messaging);
+}
+
+static void send_records(int messaging, const int *records, int count) {
+#if !defined WINCE && !defined WIN32 && !defined ANDROID && !defined IPHONE
+    write_to_ring(&queues[messaging], records, count);
+#else
+    int i;
+    for (i = 0; i < count; i++) {
+        send_record(messaging, records[i]);
+    }
+#endif
+}
+
+#if defined WINCE || defined WIN32 || defined ANDROID || defined IPHONE
+static void send_record(int messaging, int result) {
 
 #if defined WINCE
     DWORD dwBytesWritten = 0;
@@ -145,15 +250,18 @@ void send_cgreen_message(int messaging, int result) {
 #elif defined WIN32
     if(!WriteFile(queues[messaging].pWriteQueue, message, sizeof(CgreenMessage), &dwBytesWritten, NULL))
         dwBytesWritten = 0;
-#elif defined(ANDROID) || defined(IPHONE)
-	write(queues[messaging].fd[1], message, sizeof(CgreenMessage));
 #else
-    msgsnd(queues[messaging].queue, message, message_content_size(CgreenMessage), 0);
+	write(queues[messaging].fd[1], message, sizeof(CgreenMessage));
 #endif
     free(message);
 }
+#endif
+
+static int receive_record(int messaging) {
+#if !defined WINCE && !defined WIN32 && !defined ANDROID && !defined IPHONE
+    return read_from_ring(&queues[messaging]);
+#else
 
-int receive_cgreen_message(int messaging) {
 #if defined  WINCE
     DWORD dwBytesRead = 0;
     DWORD dwFlags = 0;
@@ -165,7 +273,7 @@ int receive_cgreen_message(int messaging) {
     int result = 0;
     CgreenMessage *message = malloc(sizeof(CgreenMessage));
     if (message == NULL) {
-      return -1;
+      return 0;
     }
     memset(message, 0, sizeof(CgreenMessage));
 
@@ -180,22 +288,59 @@ int receive_cgreen_message(int messaging) {
             dwBytesRead = 0;
     result = (dwBytesRead > 0 ? message->result : 0);
 
-#elif defined(ANDROID) || defined(IPHONE)
+#else
 	int nbytes = read(queues[messaging].fd[0], message, sizeof(CgreenMessage));
 	result = (nbytes > 0 ? message->result : 0);
-#else
-    ssize_t received = msgrcv(queues[messaging].queue,
-                              message,
-                              message_content_size(CgreenMessage),
-                              queues[messaging].tag,
-                              IPC_NOWAIT);
-    result = (received > 0 ? message->result : 0);
 #endif
 
     free(message);
     return result;
+#endif
+}
+
+#if !defined WINCE && !defined WIN32 && !defined ANDROID && !defined IPHONE
+static void write_to_ring(CgreenMessageQueue *queue, const int *records, int count) {
+    CgreenRing *ring = queue->ring;
+    ssize_t size = count * sizeof(int);
+    size_t used;
+    if (ring->overflowed && ring->head == ring->tail && ring->drained == ring->spilled) {
+        ring->overflowed = 0;
+    }
+    used = (size_t)(ring->tail - ring->head);
+    if (! ring->overflowed && (size_t)count <= RING_SIZE - used) {
+        int i;
+        for (i = 0; i < count; i++) {
+            ring->records[(ring->tail + i) % RING_SIZE] = records[i];
+        }
+        __sync_synchronize();
+        ring->tail += count;
+        return;
+    }
+    ring->overflowed = 1;
+    if (pwrite(fileno(queue->spill), records, size, ring->spilled) == size) {
+        __sync_synchronize();
+        ring->spilled += size;
+    }
 }
 
+static int read_from_ring(CgreenMessageQueue *queue) {
+    CgreenRing *ring = queue->ring;
+    int result = 0;
+    if (ring->head != ring->tail) {
+        __sync_synchronize();
+        result = ring->records[ring->head % RING_SIZE];
+        __sync_synchronize();
+        ring->head++;
+    } else if (ring->drained < ring->spilled) {
+        __sync_synchronize();
+        if (pread(fileno(queue->spill), &result, sizeof(result), ring->drained) == sizeof(result)) {
+            ring->drained += sizeof(result);
+        }
+    }
+    return result;
+}
+#endif
+
 static void clean_up_messaging(void) {
     int i;
     for (i = 0; i < queue_count; i++) {
@@ -210,7 +355,8 @@ static void clean_up_messaging(void) {
 		close(queues[i].fd[1]);
 #else
         if (queues[i].owner == getpid()) {
-            msgctl(queues[i].queue, IPC_RMID, NULL);
+            munmap(queues[i].ring, sizeof(CgreenRing));
+            fclose(queues[i].spill);
         }
 #endif
     }
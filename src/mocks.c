@@ -3,68 +3,209 @@
 #include <cgreen/reporter.h>
 #include <cgreen/vector.h>
 #include <cgreen/parameters.h>
+#include <cgreen/memory.h>
+#include "reporter_helpers.h"
 #include <stdlib.h>
 #include <string.h>
 
+#if defined WINCE || defined WIN32
+#define strdup _strdup
+#endif
+
+#define MOCK_JOURNAL_SIZE 4096
+
+/* Mocks can be called from several threads of the code under test at
+   once. Each function has a lock of its own for its queues, so calls
+   to different functions never wait on each other, and the tables are
+   read without any lock at all. Only adding to them takes the lock of
+   the registry. */
+#if defined WINCE || defined WIN32
+typedef int MockLock;
+#define MOCK_LOCK_INITIALIZER 0
+#define INITIALISE_LOCK(lock)
+#define DESTROY_LOCK(lock)
+#define LOCK(lock)
+#define UNLOCK(lock)
+#define LOAD_ACQUIRE(pointer) (*(pointer))
+#define STORE_RELEASE(pointer, value) (*(pointer) = (value))
+#define FETCH_AND_INCREMENT(counter) ((*(counter))++)
+#else
+#include <pthread.h>
+typedef pthread_mutex_t MockLock;
+#define MOCK_LOCK_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#define INITIALISE_LOCK(lock) pthread_mutex_init(lock, NULL)
+#define DESTROY_LOCK(lock) pthread_mutex_destroy(lock)
+#define LOCK(lock) pthread_mutex_lock(lock)
+#define UNLOCK(lock) pthread_mutex_unlock(lock)
+#define LOAD_ACQUIRE(pointer) __atomic_load_n(pointer, __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(pointer, value) __atomic_store_n(pointer, value, __ATOMIC_RELEASE)
+#define FETCH_AND_INCREMENT(counter) __sync_fetch_and_add(counter, 1)
+#endif
+
 typedef struct RecordedResult_ {
-    const char *function;
     intptr_t result;
     int should_keep;
+    struct RecordedResult_ *next;
 } RecordedResult;
 
+/* A constraint matched up with the position of its argument */
+typedef struct {
+    int argument;
+    Constraint *constraint;
+} BoundConstraint;
+
+/* The constraints are matched to argument positions the first time the
+   expectation meets a parameter list, and again only if the list is a
+   different one. */
 typedef struct RecordedExpectation_ {
     const char *function;
     const char *test_file;
     int test_line;
     int should_keep;
-    CgreenVector *constraints;
+    int sequence;
+    Constraint **constraints;
+    int constraint_count;
+    int bound_to;
+    BoundConstraint *bound;
+    int bound_count;
+    struct RecordedExpectation_ *next;
 } RecordedExpectation;
 
 typedef struct UnwantedCall_ {
     const char *test_file;
     int test_line;
-    const char *function;
+    struct UnwantedCall_ *next;
 } UnwantedCall;
 
-static CgreenVector *result_queue = NULL;
-static CgreenVector *expectation_queue = NULL;
-static CgreenVector *unwanted_calls = NULL;
-static CgreenVector *disabled_mocks = NULL;
-static CgreenVector *enabled_mocks = NULL;
+/* Everything scripted for one mocked function, with the results and
+   expectations queued in the order they were given. All of it is in the
+   test memory, and is let go of in one go at the end of the test. */
+typedef struct MockedFunction_ {
+    const char *name;
+    RecordedResult *results;
+    RecordedResult *last_result;
+    RecordedExpectation *expectations;
+    RecordedExpectation *last_expectation;
+    UnwantedCall *unwanted_calls;
+    UnwantedCall *last_unwanted_call;
+    int calls;
+    char disabled;
+    char enabled;
+    MockLock lock;
+} MockedFunction;
+
+/* The same function name can come from several string constants, as
+   from __func__ in the mock and from the test. Each address is looked
+   up once by its contents and remembered, so that later calls only
+   hash the pointer. Both tables are open addressed. The address table
+   is in the test memory and is replaced whole when it grows, so that a
+   thread still reading the old one is never left with freed memory. */
+typedef struct {
+    const char *name;
+    MockedFunction *function;
+} NameAddress;
+
+typedef struct {
+    NameAddress *entries;
+    unsigned int buckets;
+    int count;
+} AddressTable;
+
+/* The parameter names of a mock() call site, parsed on its first call
+   and kept for the life of the process. Tables it has outgrown are kept
+   until the mocks are next cleared, for the same reason as above. */
+typedef struct {
+    const char *parameters;
+    char *text;
+    CgreenVector *names;
+    int id;
+} ParsedParameters;
+
+typedef struct ParameterTable_ {
+    ParsedParameters *entries;
+    unsigned int buckets;
+    int count;
+    struct ParameterTable_ *outgrown;
+} ParameterTable;
+
+static MockedFunction **mocked_functions = NULL;
+static int mocked_function_count = 0;
+static MockedFunction **functions_by_name = NULL;
+static unsigned int name_buckets = 0;
+static AddressTable *functions_by_address = NULL;
+static int expectations_recorded = 0;
+static MockCall mock_journal[MOCK_JOURNAL_SIZE];
+static int mock_calls_journaled = 0;
+static ParameterTable *parsed_parameters = NULL;
+static int parameter_lists_parsed = 0;
 static char all_mocks_disabled = 0;
+static MockLock registry_lock = MOCK_LOCK_INITIALIZER;
 
 intptr_t stubbed_result(const char *function);
+static MockedFunction *mocked_function(const char *name);
+static MockedFunction *find_function_by_address(AddressTable *table, const char *name);
+static MockedFunction *find_function_by_name(const char *name, unsigned int hash);
+static MockedFunction *find_function(const char *name);
+static MockedFunction *create_mocked_function(const char *name, unsigned int hash);
+static void remember_address(const char *name, MockedFunction *function);
+static void grow_function_tables();
+static void grow_address_table();
+static ParsedParameters *parse_parameters(const char *parameters);
+static ParsedParameters *find_parsed_parameters(ParameterTable *table, const char *parameters);
+static ParsedParameters *add_parsed_parameters(const char *parameters);
+static void grow_parameter_table();
+static unsigned int hash_of_name(const char *name);
+static unsigned int hash_of_address(const char *name);
 static RecordedResult *create_recorded_result(const char *function, intptr_t result);
-static void ensure_result_queue_exists();
 static RecordedExpectation *create_recorded_expectation(const char *function, const char *test_file, int test_line, va_list constraints);
-static void destroy_expectation(void *expectation);
-static void ensure_expectation_queue_exists();
-static void ensure_unwanted_calls_list_exists();
-RecordedResult *find_result(const char *function);
-static void unwanted_check(const char *function);
-void trigger_unfulfilled_expectations(CgreenVector *expectation_queue, TestReporter *reporter);
-RecordedExpectation *find_expectation(const char *function);
-void apply_any_constraints(RecordedExpectation *expectation, const char *parameter, intptr_t actual);
+static RecordedResult *find_result(MockedFunction *function);
+static intptr_t next_result(MockedFunction *function);
+static void unwanted_check(MockedFunction *function);
+static void trigger_unfulfilled_expectations(TestReporter *reporter);
+static int compare_expectations(const void *first, const void *second);
+static RecordedExpectation *find_expectation(MockedFunction *function);
+static void bind_constraints(RecordedExpectation *expectation, ParsedParameters *parameters);
+static void apply_constraint(RecordedExpectation *expectation, Constraint *constraint, intptr_t actual);
+static MockCall *journal_mock_call(MockedFunction *function);
+static int oldest_journaled_call();
 
 intptr_t mock_(const char *function, const char *parameters, ...) {
+    MockedFunction *mocked = mocked_function(function);
+    ParsedParameters *parsed = parse_parameters(parameters);
+    MockCall *call;
     RecordedExpectation *expectation = NULL;
-    unwanted_check(function);
-    expectation = find_expectation(function);
+    BoundConstraint *bound = NULL;
+    BoundConstraint *end = NULL;
+    int arguments = cgreen_vector_size(parsed->names);
+    intptr_t result;
+    int i;
+    va_list actual;
+    LOCK(&mocked->lock);
+    call = journal_mock_call(mocked);
+    unwanted_check(mocked);
+    expectation = find_expectation(mocked);
     if (expectation != NULL) {
-        CgreenVector *names = create_vector_of_names(parameters);
-        int i;
-        va_list actual;
-        va_start(actual, parameters);
-        for (i = 0; i < cgreen_vector_size(names); i++) {
-            apply_any_constraints(expectation, (const char *)cgreen_vector_get(names, i), va_arg(actual, intptr_t));
+        if (expectation->bound_to != parsed->id) {
+            bind_constraints(expectation, parsed);
+        }
+        bound = expectation->bound;
+        end = bound + expectation->bound_count;
+    }
+    call->argument_count = arguments < MOCK_CALL_ARGUMENTS ? arguments : MOCK_CALL_ARGUMENTS;
+    va_start(actual, parameters);
+    for (i = 0; i < arguments; i++) {
+        intptr_t argument = va_arg(actual, intptr_t);
+        if (i < MOCK_CALL_ARGUMENTS) {
+            call->arguments[i] = argument;
         }
-        va_end(actual);
-        destroy_cgreen_vector(names);
-        if (! expectation->should_keep) {
-            destroy_expectation(expectation);
+        for (; bound < end && bound->argument == i; bound++) {
+            apply_constraint(expectation, bound->constraint, argument);
         }
     }
-    return stubbed_result(function);
+    va_end(actual);
+    result = next_result(mocked);
+    UNLOCK(&mocked->lock);
+    return result;
 }
 
 void expect_(const char *function, const char *test_file, int test_line, ...) {
@@ -86,13 +227,20 @@ void always_expect_(const char *function, const char *test_file, int test_line,
 }
 
 void expect_never_(const char *function, const char *test_file, int test_line) {
+    MockedFunction *mocked = mocked_function(function);
     UnwantedCall *unwanted = NULL;
-    ensure_unwanted_calls_list_exists();
-    unwanted = (UnwantedCall *)malloc(sizeof(UnwantedCall));
+    unwanted = (UnwantedCall *)allocate_test_memory(sizeof(UnwantedCall));
     unwanted->test_file = test_file;
     unwanted->test_line = test_line;
-    unwanted->function = function;
-    cgreen_vector_add(unwanted_calls, unwanted);
+    unwanted->next = NULL;
+    LOCK(&mocked->lock);
+    if (mocked->last_unwanted_call == NULL) {
+        mocked->unwanted_calls = unwanted;
+    } else {
+        mocked->last_unwanted_call->next = unwanted;
+    }
+    mocked->last_unwanted_call = unwanted;
+    UNLOCK(&mocked->lock);
 }
 
 void will_return_(const char *function, intptr_t result) {
@@ -105,230 +253,537 @@ void always_return_(const char *function, intptr_t result) {
     record->should_keep = 1;
 }
 
+/* No mock may be in the middle of a call, from any thread */
 void clear_mocks() {
-    if (result_queue != NULL) {
-        destroy_cgreen_vector(result_queue);
-		result_queue = NULL;
-    }
-    if (expectation_queue != NULL) {
-        destroy_cgreen_vector(expectation_queue);
-		expectation_queue = NULL;
-    }
-    if (unwanted_calls != NULL) {
-        destroy_cgreen_vector(unwanted_calls);
-		unwanted_calls = NULL;
-    }
-    if (disabled_mocks != NULL) {
-        destroy_cgreen_vector(disabled_mocks);
-		disabled_mocks = NULL;
+    int i;
+    for (i = 0; i < mocked_function_count; i++) {
+        DESTROY_LOCK(&mocked_functions[i]->lock);
     }
-    if (enabled_mocks != NULL) {
-        destroy_cgreen_vector(enabled_mocks);
-		enabled_mocks = NULL;
+    free(mocked_functions);
+    mocked_functions = NULL;
+    mocked_function_count = 0;
+    free(functions_by_name);
+    functions_by_name = NULL;
+    name_buckets = 0;
+    functions_by_address = NULL;
+    if (parsed_parameters != NULL) {
+        while (parsed_parameters->outgrown != NULL) {
+            ParameterTable *outgrown = parsed_parameters->outgrown;
+            parsed_parameters->outgrown = outgrown->outgrown;
+            free(outgrown->entries);
+            free(outgrown);
+        }
     }
+    expectations_recorded = 0;
+    mock_calls_journaled = 0;
     all_mocks_disabled = 0;
+    free_test_memory();
 }
 
 void tally_mocks(TestReporter *reporter) {
-    trigger_unfulfilled_expectations(expectation_queue, reporter);
+    trigger_unfulfilled_expectations(reporter);
     clear_mocks();
 }
 
 intptr_t stubbed_result(const char *function) {
-    intptr_t value = 0;
+    MockedFunction *mocked = mocked_function(function);
+    intptr_t result;
+    LOCK(&mocked->lock);
+    result = next_result(mocked);
+    UNLOCK(&mocked->lock);
+    return result;
+}
+
+static intptr_t next_result(MockedFunction *function) {
     RecordedResult *result = find_result(function);
     if (result == NULL) {
         return 0;
     }
-    value = result->result;
-    if (! result->should_keep) {
-        free(result);
+    return result->result;
+}
+
+static MockedFunction *mocked_function(const char *name) {
+    MockedFunction *function = find_function_by_address(LOAD_ACQUIRE(&functions_by_address), name);
+    unsigned int hash;
+    if (function != NULL) {
+        return function;
+    }
+    LOCK(&registry_lock);
+    function = find_function_by_address(functions_by_address, name);
+    if (function == NULL) {
+        hash = hash_of_name(name);
+        function = find_function_by_name(name, hash);
+        if (function == NULL) {
+            function = create_mocked_function(name, hash);
+        }
+        remember_address(name, function);
+    }
+    UNLOCK(&registry_lock);
+    return function;
+}
+
+static MockedFunction *find_function_by_address(AddressTable *table, const char *name) {
+    unsigned int mask;
+    unsigned int i;
+    const char *address;
+    if (table == NULL) {
+        return NULL;
+    }
+    mask = table->buckets - 1;
+    for (i = hash_of_address(name) & mask; (address = LOAD_ACQUIRE(&table->entries[i].name)) != NULL; i = (i + 1) & mask) {
+        if (address == name) {
+            return table->entries[i].function;
+        }
+    }
+    return NULL;
+}
+
+static MockedFunction *find_function_by_name(const char *name, unsigned int hash) {
+    unsigned int mask = name_buckets - 1;
+    unsigned int i;
+    if (name_buckets == 0) {
+        return NULL;
+    }
+    for (i = hash & mask; functions_by_name[i] != NULL; i = (i + 1) & mask) {
+        if (strcmp(functions_by_name[i]->name, name) == 0) {
+            return functions_by_name[i];
+        }
     }
-    return value;
+    return NULL;
+}
+
+static MockedFunction *find_function(const char *name) {
+    MockedFunction *function;
+    LOCK(&registry_lock);
+    function = find_function_by_name(name, hash_of_name(name));
+    UNLOCK(&registry_lock);
+    return function;
+}
+
+static MockedFunction *create_mocked_function(const char *name, unsigned int hash) {
+    MockedFunction *function;
+    unsigned int i;
+    if (2 * (unsigned int)(mocked_function_count + 1) > name_buckets) {
+        grow_function_tables();
+    }
+    function = (MockedFunction *)allocate_test_memory(sizeof(MockedFunction));
+    memset(function, 0, sizeof(MockedFunction));
+    function->name = name;
+    INITIALISE_LOCK(&function->lock);
+    for (i = hash & (name_buckets - 1); functions_by_name[i] != NULL; i = (i + 1) & (name_buckets - 1)) {
+    }
+    functions_by_name[i] = function;
+    mocked_functions[mocked_function_count++] = function;
+    return function;
+}
+
+/* The function goes in before the name, which is what readers look for */
+static void remember_address(const char *name, MockedFunction *function) {
+    AddressTable *table;
+    unsigned int i;
+    if (functions_by_address == NULL || 2 * (unsigned int)(functions_by_address->count + 1) > functions_by_address->buckets) {
+        grow_address_table();
+    }
+    table = functions_by_address;
+    for (i = hash_of_address(name) & (table->buckets - 1); table->entries[i].name != NULL; i = (i + 1) & (table->buckets - 1)) {
+    }
+    table->entries[i].function = function;
+    STORE_RELEASE(&table->entries[i].name, name);
+    table->count++;
+}
+
+/* The list of functions grows along with the name table, so it always
+   has room for as many as the table can take. */
+static void grow_function_tables() {
+    unsigned int buckets = name_buckets == 0 ? 16 : name_buckets * 2;
+    MockedFunction **by_name = (MockedFunction **)calloc(buckets, sizeof(MockedFunction *));
+    int i;
+    mocked_functions = (MockedFunction **)realloc(mocked_functions, sizeof(MockedFunction *) * buckets / 2);
+    for (i = 0; i < mocked_function_count; i++) {
+        unsigned int j = hash_of_name(mocked_functions[i]->name) & (buckets - 1);
+        while (by_name[j] != NULL) {
+            j = (j + 1) & (buckets - 1);
+        }
+        by_name[j] = mocked_functions[i];
+    }
+    free(functions_by_name);
+    functions_by_name = by_name;
+    name_buckets = buckets;
+}
+
+static void grow_address_table() {
+    AddressTable *old = functions_by_address;
+    AddressTable *table = (AddressTable *)allocate_test_memory(sizeof(AddressTable));
+    unsigned int i;
+    table->buckets = old == NULL ? 32 : old->buckets * 2;
+    table->entries = (NameAddress *)allocate_test_memory(sizeof(NameAddress) * table->buckets);
+    memset(table->entries, 0, sizeof(NameAddress) * table->buckets);
+    table->count = 0;
+    for (i = 0; old != NULL && i < old->buckets; i++) {
+        if (old->entries[i].name != NULL) {
+            unsigned int j = hash_of_address(old->entries[i].name) & (table->buckets - 1);
+            while (table->entries[j].name != NULL) {
+                j = (j + 1) & (table->buckets - 1);
+            }
+            table->entries[j] = old->entries[i];
+            table->count++;
+        }
+    }
+    STORE_RELEASE(&functions_by_address, table);
+}
+
+/* Call sites pass a string constant, so the address is enough to find
+   it again. The contents are still compared in case a caller reused the
+   memory for another list. */
+static ParsedParameters *parse_parameters(const char *parameters) {
+    ParsedParameters *parsed;
+    if (parameters == NULL) {
+        parameters = "";
+    }
+    parsed = find_parsed_parameters(LOAD_ACQUIRE(&parsed_parameters), parameters);
+    if (parsed != NULL) {
+        return parsed;
+    }
+    LOCK(&registry_lock);
+    parsed = find_parsed_parameters(parsed_parameters, parameters);
+    if (parsed == NULL) {
+        parsed = add_parsed_parameters(parameters);
+    }
+    UNLOCK(&registry_lock);
+    return parsed;
+}
+
+static ParsedParameters *find_parsed_parameters(ParameterTable *table, const char *parameters) {
+    unsigned int mask;
+    unsigned int i;
+    const char *address;
+    if (table == NULL) {
+        return NULL;
+    }
+    mask = table->buckets - 1;
+    for (i = hash_of_address(parameters) & mask; (address = LOAD_ACQUIRE(&table->entries[i].parameters)) != NULL; i = (i + 1) & mask) {
+        if (address == parameters && strcmp(table->entries[i].text, parameters) == 0) {
+            return &table->entries[i];
+        }
+    }
+    return NULL;
+}
+
+/* A list already parsed at the same address is parsed again in place */
+static ParsedParameters *add_parsed_parameters(const char *parameters) {
+    ParsedParameters *entries;
+    unsigned int mask;
+    unsigned int i;
+    if (parsed_parameters == NULL || 2 * (unsigned int)(parsed_parameters->count + 1) > parsed_parameters->buckets) {
+        grow_parameter_table();
+    }
+    entries = parsed_parameters->entries;
+    mask = parsed_parameters->buckets - 1;
+    for (i = hash_of_address(parameters) & mask; entries[i].parameters != NULL; i = (i + 1) & mask) {
+        if (entries[i].parameters == parameters) {
+            free(entries[i].text);
+            destroy_cgreen_vector(entries[i].names);
+            parsed_parameters->count--;
+            break;
+        }
+    }
+    entries[i].text = strdup(parameters);
+    entries[i].names = create_vector_of_names(parameters);
+    entries[i].id = parameter_lists_parsed++;
+    STORE_RELEASE(&entries[i].parameters, parameters);
+    parsed_parameters->count++;
+    return &entries[i];
+}
+
+static void grow_parameter_table() {
+    ParameterTable *old = parsed_parameters;
+    ParameterTable *table = (ParameterTable *)malloc(sizeof(ParameterTable));
+    unsigned int i;
+    table->buckets = old == NULL ? 64 : old->buckets * 2;
+    table->entries = (ParsedParameters *)calloc(table->buckets, sizeof(ParsedParameters));
+    table->count = 0;
+    table->outgrown = old;
+    for (i = 0; old != NULL && i < old->buckets; i++) {
+        if (old->entries[i].parameters != NULL) {
+            unsigned int j = hash_of_address(old->entries[i].parameters) & (table->buckets - 1);
+            while (table->entries[j].parameters != NULL) {
+                j = (j + 1) & (table->buckets - 1);
+            }
+            table->entries[j] = old->entries[i];
+            table->count++;
+        }
+    }
+    STORE_RELEASE(&parsed_parameters, table);
+}
+
+static unsigned int hash_of_name(const char *name) {
+    unsigned int hash = 2166136261u;
+    for (; *name != '\0'; name++) {
+        hash = (hash ^ (unsigned char)*name) * 16777619u;
+    }
+    return hash;
+}
+
+static unsigned int hash_of_address(const char *name) {
+    uintptr_t address = (uintptr_t)name;
+    return (unsigned int)((address ^ (address >> 16)) * 2654435761u);
 }
 
 static RecordedResult *create_recorded_result(const char *function, intptr_t result) {
+    MockedFunction *mocked = mocked_function(function);
     RecordedResult *record = NULL;
 
-    ensure_result_queue_exists();
-    record = (RecordedResult *)malloc(sizeof(RecordedResult));
-    record->function = function;
+    record = (RecordedResult *)allocate_test_memory(sizeof(RecordedResult));
     record->result = result;
-    cgreen_vector_add(result_queue, record);
-    return record;
-}
-
-static void ensure_result_queue_exists() {
-    if (result_queue == NULL) {
-        result_queue = create_cgreen_vector(&free);
+    record->next = NULL;
+    LOCK(&mocked->lock);
+    if (mocked->last_result == NULL) {
+        mocked->results = record;
+    } else {
+        mocked->last_result->next = record;
     }
+    mocked->last_result = record;
+    UNLOCK(&mocked->lock);
+    return record;
 }
 
 static RecordedExpectation *create_recorded_expectation(const char *function, const char *test_file, int test_line, va_list constraints) {
+    MockedFunction *mocked = mocked_function(function);
     RecordedExpectation *expectation = NULL;
     Constraint *constraint = NULL;
 
-    ensure_expectation_queue_exists();
-    expectation = (RecordedExpectation *)malloc(sizeof(RecordedExpectation));
+    expectation = (RecordedExpectation *)allocate_test_memory(sizeof(RecordedExpectation));
     expectation->function = function;
     expectation->test_file = test_file;
     expectation->test_line = test_line;
-    expectation->constraints = create_cgreen_vector(&destroy_constraint);
+    expectation->sequence = FETCH_AND_INCREMENT(&expectations_recorded);
+    expectation->constraints = NULL;
+    expectation->constraint_count = 0;
+    expectation->bound_to = -1;
+    expectation->bound = NULL;
+    expectation->bound_count = 0;
+    expectation->next = NULL;
 
     while ((constraint = va_arg(constraints, Constraint *)) != (Constraint *)0) {
-        cgreen_vector_add(expectation->constraints, constraint);
+        expectation->constraints = (Constraint **)reallocate_test_memory(
+                expectation->constraints, sizeof(Constraint *) * (expectation->constraint_count + 1));
+        expectation->constraints[expectation->constraint_count++] = constraint;
     }
-    cgreen_vector_add(expectation_queue, expectation);
+    LOCK(&mocked->lock);
+    if (mocked->last_expectation == NULL) {
+        mocked->expectations = expectation;
+    } else {
+        mocked->last_expectation->next = expectation;
+    }
+    mocked->last_expectation = expectation;
+    UNLOCK(&mocked->lock);
     return expectation;
 }
 
-static void destroy_expectation(void *abstract) {
-    RecordedExpectation *expectation = (RecordedExpectation *)abstract;
-    destroy_cgreen_vector(expectation->constraints);
-    free(expectation);
-}
-
-static void ensure_expectation_queue_exists() {
-    if (expectation_queue == NULL) {
-        expectation_queue = create_cgreen_vector(&destroy_expectation);
+static RecordedResult *find_result(MockedFunction *function) {
+    RecordedResult *result = function->results;
+    if (result != NULL && ! result->should_keep) {
+        function->results = result->next;
+        if (function->results == NULL) {
+            function->last_result = NULL;
+        }
     }
+    return result;
 }
 
-static void ensure_unwanted_calls_list_exists() {
-    if (unwanted_calls == NULL) {
-        unwanted_calls = create_cgreen_vector(&free);
+static void unwanted_check(MockedFunction *function) {
+    UnwantedCall *unwanted;
+    for (unwanted = function->unwanted_calls; unwanted != NULL; unwanted = unwanted->next) {
+        (*get_test_reporter()->assert_true)(
+                get_test_reporter(),
+                unwanted->test_file,
+                unwanted->test_line,
+                0,
+                "Unexpected call to function [%s]", function->name);
     }
 }
 
-RecordedResult *find_result(const char *function) {
+/* Reported in the order the expectations were set up, whatever the
+   functions they belong to. */
+static void trigger_unfulfilled_expectations(TestReporter *reporter) {
+    RecordedExpectation **unfulfilled = NULL;
+    int count = 0;
     int i;
-    for (i = 0; i < cgreen_vector_size(result_queue); i++) {
-        RecordedResult *result = (RecordedResult *)cgreen_vector_get(result_queue, i);
-        if (strcmp(result->function, function) == 0) {
-            if (! result->should_keep) {
-                return (RecordedResult *) cgreen_vector_remove(result_queue, i);
+    for (i = 0; i < mocked_function_count; i++) {
+        RecordedExpectation *expectation;
+        for (expectation = mocked_functions[i]->expectations; expectation != NULL; expectation = expectation->next) {
+            if (! expectation->should_keep) {
+                count++;
             }
-            return result;
         }
     }
-    return NULL;
+    if (count == 0) {
+        return;
+    }
+    unfulfilled = (RecordedExpectation **)allocate_test_memory(sizeof(RecordedExpectation *) * count);
+    count = 0;
+    for (i = 0; i < mocked_function_count; i++) {
+        RecordedExpectation *expectation;
+        for (expectation = mocked_functions[i]->expectations; expectation != NULL; expectation = expectation->next) {
+            if (! expectation->should_keep) {
+                unfulfilled[count++] = expectation;
+            }
+        }
+    }
+    qsort(unfulfilled, count, sizeof(RecordedExpectation *), &compare_expectations);
+    for (i = 0; i < count; i++) {
+        (*reporter->assert_true)(
+                reporter,
+                unfulfilled[i]->test_file,
+                unfulfilled[i]->test_line,
+                0,
+                "Call was not made to function [%s]", unfulfilled[i]->function);
+    }
 }
 
-static void unwanted_check(const char *function) {
-    int i;
-    for (i = 0; i < cgreen_vector_size(unwanted_calls); i++) {
-        UnwantedCall *unwanted = (UnwantedCall *) cgreen_vector_get(unwanted_calls, i);
-        if (strcmp(unwanted->function, function) == 0) {
-            (*get_test_reporter()->assert_true)(
-                    get_test_reporter(),
-                    unwanted->test_file,
-                    unwanted->test_line,
-                    0,
-                    "Unexpected call to function [%s]", function);
+static int compare_expectations(const void *first, const void *second) {
+    return (*(RecordedExpectation * const *)first)->sequence -
+           (*(RecordedExpectation * const *)second)->sequence;
+}
+
+static RecordedExpectation *find_expectation(MockedFunction *function) {
+    RecordedExpectation *expectation = function->expectations;
+    if (expectation != NULL && ! expectation->should_keep) {
+        function->expectations = expectation->next;
+        if (function->expectations == NULL) {
+            function->last_expectation = NULL;
         }
     }
+    return expectation;
 }
 
-void trigger_unfulfilled_expectations(CgreenVector *expect_queue,
-                                      TestReporter *reporter) {
-    int i;
-    for (i = 0; i < cgreen_vector_size(expectation_queue); i++) {
-        RecordedExpectation *expectation = cgreen_vector_get(expect_queue, i);
-        if (! expectation->should_keep) {
-            (*reporter->assert_true)(
-                    reporter,
-                    expectation->test_file,
-                    expectation->test_line,
-                    0,
-                    "Call was not made to function [%s]", expectation->function);
+/* Bound in argument order, and in the order they were given for the
+   same argument, which is the order they are applied in. */
+static void bind_constraints(RecordedExpectation *expectation, ParsedParameters *parameters) {
+    int constraints = expectation->constraint_count;
+    int names = cgreen_vector_size(parameters->names);
+    int i, j;
+    expectation->bound = (BoundConstraint *)allocate_test_memory(sizeof(BoundConstraint) * (constraints * names + 1));
+    expectation->bound_count = 0;
+    for (i = 0; i < names; i++) {
+        const char *name = (const char *)cgreen_vector_get(parameters->names, i);
+        for (j = 0; j < constraints; j++) {
+            Constraint *constraint = expectation->constraints[j];
+            if (is_constraint_parameter(constraint, name)) {
+                expectation->bound[expectation->bound_count].argument = i;
+                expectation->bound[expectation->bound_count].constraint = constraint;
+                expectation->bound_count++;
+            }
         }
     }
+    expectation->bound_to = parameters->id;
+}
+
+static void apply_constraint(RecordedExpectation *expectation, Constraint *constraint, intptr_t actual) {
+	switch(constraint->constraint_type)
+	{
+	case CG_CONSTRAINT_WANT:
+		test_constraint(
+				constraint,
+				expectation->function,
+				actual,
+				expectation->test_file,
+				expectation->test_line,
+				get_test_reporter());
+	break;
+	case CG_CONSTRAINT_SET:
+		*((int *)actual) = (int)constraint->out_value;
+		break;
+
+	case CG_CONSTRAINT_FILL:
+		memcpy((void *)actual, (void *)constraint->out_value, constraint->copy_size);
+		break;
+	}
+}
+
+void disable_all_mocks() {
+    all_mocks_disabled = 1;
+}
+
+/* The queries look functions up by name alone, so that they neither
+   create records nor remember the addresses of names that may not last. */
+int mock_call_count_(const char *function) {
+    MockedFunction *mocked = find_function(function);
+    return mocked == NULL ? 0 : mocked->calls;
 }
 
-RecordedExpectation *find_expectation(const char *function) {
+const MockCall *nth_mock_call_(const char *function, int n) {
+    MockedFunction *mocked = find_function(function);
     int i;
-    for (i = 0; i < cgreen_vector_size(expectation_queue); i++) {
-        RecordedExpectation *expectation =
-                (RecordedExpectation *)cgreen_vector_get(expectation_queue, i);
-        if (strcmp(expectation->function, function) == 0) {
-            if (! expectation->should_keep) {
-                return (RecordedExpectation *) cgreen_vector_remove(expectation_queue, i);
-            }
-            return expectation;
+    if (mocked == NULL || n < 1 || n > mocked->calls) {
+        return NULL;
+    }
+    for (i = mock_calls_journaled - 1; i >= oldest_journaled_call(); i--) {
+        MockCall *call = &mock_journal[i & (MOCK_JOURNAL_SIZE - 1)];
+        if (call->function == mocked->name && call->call == n) {
+            return call;
         }
     }
     return NULL;
 }
 
-void apply_any_constraints(RecordedExpectation *expectation, const char *parameter, intptr_t actual) {
+/* True if the journal holds calls to the functions in this order, with
+   any other calls in between */
+int mock_calls_in_order_(const char *functions) {
+    CgreenVector *names = create_vector_of_names(functions);
+    int count = cgreen_vector_size(names);
+    const char **interned = (const char **)allocate_test_memory(sizeof(const char *) * (count + 1));
+    int matched = 0;
     int i;
-    for (i = 0; i < cgreen_vector_size(expectation->constraints); i++) {
-        Constraint *constraint = (Constraint *)cgreen_vector_get(expectation->constraints, i);
-        if (is_constraint_parameter(constraint, parameter)) {
-			switch(constraint->constraint_type)
-			{
-			case CG_CONSTRAINT_WANT:
-				test_constraint(
-						constraint,
-						expectation->function,
-						actual,
-						expectation->test_file,
-						expectation->test_line,
-						get_test_reporter());
-			break;
-			case CG_CONSTRAINT_SET:
-				*((int *)actual) = (int)constraint->out_value;
-				break;
-
-			case CG_CONSTRAINT_FILL:
-				memcpy((void *)actual, (void *)constraint->out_value, constraint->copy_size);
-				break;
-			}
+    for (i = 0; i < count; i++) {
+        const char *name = (const char *)cgreen_vector_get(names, i);
+        MockedFunction *mocked = find_function(name);
+        interned[i] = (mocked == NULL ? NULL : mocked->name);
+    }
+    destroy_cgreen_vector(names);
+    for (i = oldest_journaled_call(); i < mock_calls_journaled && matched < count; i++) {
+        if (mock_journal[i & (MOCK_JOURNAL_SIZE - 1)].function == interned[matched]) {
+            matched++;
         }
     }
+    return matched == count;
 }
 
-void disable_all_mocks() {
-    all_mocks_disabled = 1;
+/* Overwrites the oldest call once the journal is full. The sequence is
+   taken while the function is locked, so that it is also the order in
+   which the calls took their results and expectations, from whichever
+   thread they came. */
+static MockCall *journal_mock_call(MockedFunction *function) {
+    int journaled = FETCH_AND_INCREMENT(&mock_calls_journaled);
+    MockCall *call = &mock_journal[journaled & (MOCK_JOURNAL_SIZE - 1)];
+    call->function = function->name;
+    call->call = ++function->calls;
+    call->sequence = journaled + 1;
+    call->time = monotonic_seconds_now();
+    call->argument_count = 0;
+    return call;
+}
+
+static int oldest_journaled_call() {
+    return mock_calls_journaled > MOCK_JOURNAL_SIZE ? mock_calls_journaled - MOCK_JOURNAL_SIZE : 0;
 }
 
 int mock_enabled_(const char *function) {
-    int i;
+    MockedFunction *mocked = mocked_function(function);
     if (all_mocks_disabled) {
         // Mocks disabled by default, check for any that are enabled
-        for (i = 0; i < cgreen_vector_size(enabled_mocks); i++) {
-            char *enabled_mock = (char *)cgreen_vector_get(enabled_mocks, i);
-            if (strcmp(enabled_mock, function) == 0) {
-                return 1;
-            }
-        }
-        return 0;
-    } else {
-        // Mocks enabled by default, check for any that are disabled
-        for (i = 0; i < cgreen_vector_size(disabled_mocks); i++) {
-            char *disabled_mock = (char *)cgreen_vector_get(disabled_mocks, i);
-            if (strcmp(disabled_mock, function) == 0) {
-                return 0;
-            }
-        }
-        return 1;
+        return mocked->enabled;
     }
-    // Should never reach here
-    return 1;
+    // Mocks enabled by default, check for any that are disabled
+    return ! mocked->disabled;
 }
 
 void disable_mock_(const char *function) {
-    if (disabled_mocks == NULL) {
-        disabled_mocks = create_cgreen_vector(NULL);
-    }
-    cgreen_vector_add(disabled_mocks, (void *)function);
+    mocked_function(function)->disabled = 1;
 }
 
 void enable_mock_(const char *function) {
-    if (enabled_mocks == NULL) {
-        enabled_mocks = create_cgreen_vector(NULL);
-    }
-    cgreen_vector_add(enabled_mocks, (void *)function);
+    mocked_function(function)->enabled = 1;
 }
 
 /* vim: set ts=4 sw=4 et cindent: */
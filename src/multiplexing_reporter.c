@@ -0,0 +1,188 @@
+#include <cgreen/multiplexing_reporter.h>
+#include <cgreen/reporter.h>
+#include <cgreen/breadcrumb.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#ifndef va_copy
+#define va_copy(copy, original) ((copy) = (original))
+#endif
+
+/* The results are read from the queue and counted once, by the
+   multiplexer, and then relayed to each of the reporters in turn as
+   their own reporter_finish() asks for them. A reporter that does not
+   ask is not left holding them. A multiplexer under another one relays
+   the results it was given. */
+typedef struct {
+    TestReporter **children;
+    int count;
+    ReporterResults *results;
+    ReporterResults *taken;
+} MultiplexingMemo;
+
+static void destroy_multiplexing_reporter(TestReporter *reporter);
+static void multiplexing_start_suite(TestReporter *reporter, const char *name, const int number_of_tests);
+static void multiplexing_start_test(TestReporter *reporter, const char *name);
+static void show_pass(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments);
+static void show_fail(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments);
+static void show_incomplete(TestReporter *reporter, const char *name);
+static void record_metrics(TestReporter *reporter, const char *name, const TestMetrics *metrics);
+static void multiplexing_finish_test(TestReporter *reporter, const char *name);
+static void multiplexing_finish_suite(TestReporter *reporter, const char *name);
+static void take_results(TestReporter *reporter);
+static void relay_results(TestReporter *reporter, TestReporter *child);
+
+TestReporter *create_multiplexing_reporter(TestReporter **children, int count) {
+    TestReporter *reporter;
+    MultiplexingMemo *memo;
+    int i;
+
+    if (children == NULL || count < 0) {
+        return NULL;
+    }
+    for (i = 0; i < count; i++) {
+        if (children[i] == NULL) {
+            return NULL;
+        }
+    }
+    reporter = create_reporter();
+    if (reporter == NULL) {
+        return NULL;
+    }
+    memo = (MultiplexingMemo *)malloc(sizeof(MultiplexingMemo));
+    if (memo == NULL) {
+        destroy_reporter(reporter);
+        return NULL;
+    }
+    memo->count = count;
+    memo->children = (TestReporter **)malloc((count > 0 ? count : 1) * sizeof(TestReporter *));
+    memo->results = create_reporter_results();
+    memo->taken = memo->results;
+    if (memo->children == NULL || memo->results == NULL) {
+        free(memo->children);
+        destroy_reporter_results(memo->results);
+        free(memo);
+        destroy_reporter(reporter);
+        return NULL;
+    }
+    memcpy(memo->children, children, count * sizeof(TestReporter *));
+    reporter->destroy = &destroy_multiplexing_reporter;
+    reporter->start_suite = &multiplexing_start_suite;
+    reporter->start_test = &multiplexing_start_test;
+    reporter->show_pass = &show_pass;
+    reporter->show_fail = &show_fail;
+    reporter->show_incomplete = &show_incomplete;
+    reporter->record_metrics = &record_metrics;
+    reporter->finish_test = &multiplexing_finish_test;
+    reporter->finish_suite = &multiplexing_finish_suite;
+    reporter->memo = memo;
+    return reporter;
+}
+
+static void destroy_multiplexing_reporter(TestReporter *reporter) {
+    MultiplexingMemo *memo = (MultiplexingMemo *)reporter->memo;
+    int i;
+    if (memo != NULL) {
+        for (i = 0; i < memo->count; i++) {
+            (*memo->children[i]->destroy)(memo->children[i]);
+        }
+        free(memo->children);
+        destroy_reporter_results(memo->results);
+        free(memo);
+        reporter->memo = NULL;
+    }
+    destroy_reporter(reporter);
+}
+
+static void multiplexing_start_suite(TestReporter *reporter, const char *name, const int number_of_tests) {
+    MultiplexingMemo *memo = (MultiplexingMemo *)reporter->memo;
+    int i;
+    reporter_start_suite(reporter, name, number_of_tests);
+    for (i = 0; i < memo->count; i++) {
+        (*memo->children[i]->start_suite)(memo->children[i], name, number_of_tests);
+    }
+}
+
+static void multiplexing_start_test(TestReporter *reporter, const char *name) {
+    MultiplexingMemo *memo = (MultiplexingMemo *)reporter->memo;
+    int i;
+    reporter_start(reporter, name);
+    for (i = 0; i < memo->count; i++) {
+        (*memo->children[i]->start_test)(memo->children[i], name);
+    }
+}
+
+static void show_pass(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments) {
+    MultiplexingMemo *memo = (MultiplexingMemo *)reporter->memo;
+    va_list copy;
+    int i;
+    for (i = 0; i < memo->count; i++) {
+        va_copy(copy, arguments);
+        (*memo->children[i]->show_pass)(memo->children[i], file, line, message, copy);
+        va_end(copy);
+    }
+}
+
+static void show_fail(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments) {
+    MultiplexingMemo *memo = (MultiplexingMemo *)reporter->memo;
+    va_list copy;
+    int i;
+    for (i = 0; i < memo->count; i++) {
+        va_copy(copy, arguments);
+        (*memo->children[i]->show_fail)(memo->children[i], file, line, message, copy);
+        va_end(copy);
+    }
+}
+
+static void show_incomplete(TestReporter *reporter, const char *name) {
+    MultiplexingMemo *memo = (MultiplexingMemo *)reporter->memo;
+    int i;
+    for (i = 0; i < memo->count; i++) {
+        (*memo->children[i]->show_incomplete)(memo->children[i], name);
+    }
+}
+
+static void record_metrics(TestReporter *reporter, const char *name, const TestMetrics *metrics) {
+    MultiplexingMemo *memo = (MultiplexingMemo *)reporter->memo;
+    int i;
+    for (i = 0; i < memo->count; i++) {
+        (*memo->children[i]->record_metrics)(memo->children[i], name, metrics);
+    }
+}
+
+static void multiplexing_finish_test(TestReporter *reporter, const char *name) {
+    MultiplexingMemo *memo = (MultiplexingMemo *)reporter->memo;
+    int i;
+    take_results(reporter);
+    for (i = 0; i < memo->count; i++) {
+        relay_results(reporter, memo->children[i]);
+        (*memo->children[i]->finish_test)(memo->children[i], name);
+        relay_reporter_results(memo->children[i], NULL);
+    }
+}
+
+static void multiplexing_finish_suite(TestReporter *reporter, const char *name) {
+    MultiplexingMemo *memo = (MultiplexingMemo *)reporter->memo;
+    int i;
+    take_results(reporter);
+    for (i = 0; i < memo->count; i++) {
+        relay_results(reporter, memo->children[i]);
+        (*memo->children[i]->finish_suite)(memo->children[i], name);
+        relay_reporter_results(memo->children[i], NULL);
+    }
+}
+
+static void take_results(TestReporter *reporter) {
+    MultiplexingMemo *memo = (MultiplexingMemo *)reporter->memo;
+    memo->taken = take_reporter_results(reporter, memo->results);
+    pop_breadcrumb((CgreenBreadcrumb *)reporter->breadcrumb);
+}
+
+static void relay_results(TestReporter *reporter, TestReporter *child) {
+    MultiplexingMemo *memo = (MultiplexingMemo *)reporter->memo;
+    child->ipc = reporter->ipc;
+    relay_reporter_results(child, memo->taken);
+}
+
+/* vim: set ts=4 sw=4 et cindent: */
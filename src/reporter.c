@@ -1,14 +1,54 @@
 #include <cgreen/reporter.h>
 #include <cgreen/messaging.h>
 #include <cgreen/breadcrumb.h>
+#include "reporter_helpers.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #if !defined WIN32 && !defined WINCE && !defined ANDROID
 #include <sys/msg.h>
 #endif
+#if !defined WIN32 && !defined WINCE
+#include <pthread.h>
+#endif
 #include <stdarg.h>
 
+/* Passes are counted where the test runs and sent on in one go as a
+   single result of completion plus the count, at least this often. */
 enum {pass = 1, fail, completion};
+#define PASSES_PER_CHECKPOINT 1024
+
+/* Assertions can come from threads of the code under test, through the
+   mocks. Passes are counted without a lock, and only the messages sent
+   on take one, so that they go out whole. */
+#if defined WIN32 || defined WINCE
+#define LOCK_RESULTS()
+#define UNLOCK_RESULTS()
+#define COUNT_PASS(counter) (++*(counter))
+#define TAKE_PASSES(counter) take_passes(counter)
+static int take_passes(int *counter) {
+    int passes = *counter;
+    *counter = 0;
+    return passes;
+}
+#else
+static pthread_mutex_t results_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_RESULTS() pthread_mutex_lock(&results_lock)
+#define UNLOCK_RESULTS() pthread_mutex_unlock(&results_lock)
+#define COUNT_PASS(counter) __atomic_add_fetch(counter, 1, __ATOMIC_RELAXED)
+#define TAKE_PASSES(counter) __atomic_exchange_n(counter, 0, __ATOMIC_ACQ_REL)
+#endif
+
+/* Failures are kept as they arrived, to be shown to each reporter */
+struct ReporterResults_ {
+    int passes;
+    int completed;
+    char **failures;
+    size_t *sizes;
+    int failure_count;
+    int failure_space;
+    int lost_failures;
+};
 
 struct TestContext_ {
 	TestReporter *reporter;
@@ -18,17 +58,29 @@ static TestContext context;
 static void show_pass(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments);
 static void show_fail(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments);
 static void show_incomplete(TestReporter *reporter, const char *name);
+static void record_metrics(TestReporter *reporter, const char *name, const TestMetrics *metrics);
 static void assert_true(TestReporter *reporter, const char *file, int line, int result, const char *message, ...);
 static void read_reporter_results(TestReporter *reporter);
+static void read_relayed_results(TestReporter *reporter, ReporterResults *results);
+static void count_taken_results(TestReporter *reporter, ReporterResults *results);
+static void forget_reporter_results(ReporterResults *results);
+static int keep_failure(ReporterResults *results, void *payload, size_t size);
+static void send_reporter_passes(TestReporter *reporter);
+static void send_reporter_failure(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments);
+static void show_failure_from(TestReporter *reporter, const char *payload, size_t size);
+static void show_failure(TestReporter *reporter, const char *file, int line, const char *message, ...);
 
 TestReporter *get_test_reporter() {
 	return context.reporter;
 }
 
+void set_test_reporter(TestReporter *reporter) {
+	context.reporter = reporter;
+}
+
 int setup_reporting(TestReporter *reporter) {
     reporter->ipc = start_cgreen_messaging(45);
     if (reporter->ipc == -1) {
-        free(reporter);
         return -1;
     }
     context.reporter = reporter;
@@ -55,9 +107,12 @@ TestReporter *create_reporter() {
     reporter->assert_true = &assert_true;
     reporter->finish_test = &reporter_finish;
     reporter->finish_suite = &reporter_finish;
+    reporter->record_metrics = &record_metrics;
     reporter->passes = 0;
     reporter->failures = 0;
     reporter->exceptions = 0;
+    reporter->unsent_passes = 0;
+    reporter->relayed_results = NULL;
     reporter->breadcrumb = breadcrumb;
     reporter->memo = NULL;
     reporter->log_depth = 1;
@@ -94,13 +149,24 @@ void reporter_finish(TestReporter *reporter, const char *name) {
 }
 
 void add_reporter_result(TestReporter *reporter, int result) {
-    send_cgreen_message(reporter->ipc, result ? pass : fail);
+    if (! result) {
+        LOCK_RESULTS();
+        send_cgreen_message(reporter->ipc, fail);
+        UNLOCK_RESULTS();
+    } else if (COUNT_PASS(&reporter->unsent_passes) == PASSES_PER_CHECKPOINT) {
+        send_reporter_passes(reporter);
+    }
 }
 
 void send_reporter_completion_notification(TestReporter *reporter) {
+    send_reporter_passes(reporter);
     send_cgreen_message(reporter->ipc, completion);
 }
 
+int is_reporter_completion_notification(int message) {
+    return message == completion;
+}
+
 static void show_pass(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments) {
 }
 
@@ -110,29 +176,49 @@ static void show_fail(TestReporter *reporter, const char *file, int line, const
 static void show_incomplete(TestReporter *reporter, const char *name) {
 }
 
+static void record_metrics(TestReporter *reporter, const char *name, const TestMetrics *metrics) {
+    (void) reporter;
+    (void) name;
+    (void) metrics;
+}
+
 static void assert_true(TestReporter *reporter, const char *file, int line, int result, const char *message, ...) {
     va_list arguments;
     va_start(arguments, message);
 	if (result) {
     	(*reporter->show_pass)(reporter, file, line, message, arguments);
+		add_reporter_result(reporter, result);
 	} else {
-    	(*reporter->show_fail)(reporter, file, line, message, arguments);
+		LOCK_RESULTS();
+		send_reporter_failure(reporter, file, line, message, arguments);
+		UNLOCK_RESULTS();
 	}
-	add_reporter_result(reporter, result);
 	va_end(arguments);
 }
 
 static void read_reporter_results(TestReporter *reporter) {
     int completed = 0;
     int result;
-    while ((result = receive_cgreen_message(reporter->ipc)) > 0) {
+    void *payload;
+    size_t size;
+    if (reporter->relayed_results != NULL) {
+        read_relayed_results(reporter, (ReporterResults *)reporter->relayed_results);
+        reporter->relayed_results = NULL;
+        return;
+    }
+    send_reporter_passes(reporter);
+    while ((result = receive_cgreen_message_with_payload(reporter->ipc, &payload, &size)) > 0) {
         if (result == pass) {
             reporter->passes++;
         } else if (result == fail) {
+            show_failure_from(reporter, (const char *)payload, size);
             reporter->failures++;
         } else if (result == completion) {
             completed = 1;
+        } else {
+            reporter->passes += result - completion;
         }
+        free(payload);
     }
     if (! completed) {
         (*reporter->show_incomplete)(reporter, get_current_from_breadcrumb((CgreenBreadcrumb *)reporter->breadcrumb));
@@ -144,4 +230,195 @@ void set_log_depth(TestReporter *reporter, int log_depth) {
     reporter->log_depth = log_depth;
 }
 
+ReporterResults *create_reporter_results() {
+    ReporterResults *results = (ReporterResults *)malloc(sizeof(ReporterResults));
+    if (results == NULL) {
+        return NULL;
+    }
+    results->passes = 0;
+    results->completed = 0;
+    results->failures = NULL;
+    results->sizes = NULL;
+    results->failure_count = 0;
+    results->failure_space = 0;
+    results->lost_failures = 0;
+    return results;
+}
+
+void destroy_reporter_results(ReporterResults *results) {
+    if (results == NULL) {
+        return;
+    }
+    forget_reporter_results(results);
+    free(results->failures);
+    free(results->sizes);
+    free(results);
+}
+
+/* Reads and counts the results like reporter_finish(), but keeps them
+   instead of showing them, and leaves the breadcrumb alone. Results
+   relayed to this reporter have been read already, so those are counted
+   and given back instead. */
+ReporterResults *take_reporter_results(TestReporter *reporter, ReporterResults *results) {
+    int result;
+    void *payload;
+    size_t size;
+    if (reporter->relayed_results != NULL) {
+        results = (ReporterResults *)reporter->relayed_results;
+        reporter->relayed_results = NULL;
+        count_taken_results(reporter, results);
+        return results;
+    }
+    forget_reporter_results(results);
+    send_reporter_passes(reporter);
+    while ((result = receive_cgreen_message_with_payload(reporter->ipc, &payload, &size)) > 0) {
+        if (result == pass) {
+            results->passes++;
+        } else if (result == fail) {
+            if (keep_failure(results, payload, size)) {
+                continue;
+            }
+            results->lost_failures++;
+        } else if (result == completion) {
+            results->completed = 1;
+        } else {
+            results->passes += result - completion;
+        }
+        free(payload);
+    }
+    count_taken_results(reporter, results);
+    return results;
+}
+
+/* The next reporter_finish() shows and counts these results instead of
+   reading the queue. They must outlive that call. */
+void relay_reporter_results(TestReporter *reporter, ReporterResults *results) {
+    reporter->relayed_results = results;
+}
+
+static void read_relayed_results(TestReporter *reporter, ReporterResults *results) {
+    int i;
+    reporter->passes += results->passes;
+    for (i = 0; i < results->failure_count; i++) {
+        show_failure_from(reporter, results->failures[i], results->sizes[i]);
+        reporter->failures++;
+    }
+    for (i = 0; i < results->lost_failures; i++) {
+        show_failure(reporter, "", 0, NULL);
+        reporter->failures++;
+    }
+    if (! results->completed) {
+        (*reporter->show_incomplete)(reporter, get_current_from_breadcrumb((CgreenBreadcrumb *)reporter->breadcrumb));
+        reporter->exceptions++;
+    }
+}
+
+static void count_taken_results(TestReporter *reporter, ReporterResults *results) {
+    reporter->passes += results->passes;
+    reporter->failures += results->failure_count + results->lost_failures;
+    if (! results->completed) {
+        reporter->exceptions++;
+    }
+}
+
+static void forget_reporter_results(ReporterResults *results) {
+    int i;
+    for (i = 0; i < results->failure_count; i++) {
+        free(results->failures[i]);
+    }
+    results->passes = 0;
+    results->completed = 0;
+    results->failure_count = 0;
+    results->lost_failures = 0;
+}
+
+/* A failure that cannot be kept for want of memory is only counted */
+static int keep_failure(ReporterResults *results, void *payload, size_t size) {
+    int space;
+    char **failures;
+    size_t *sizes;
+    if (results->failure_count == results->failure_space) {
+        space = (results->failure_space == 0 ? 4 : results->failure_space * 2);
+        failures = (char **)realloc(results->failures, space * sizeof(char *));
+        if (failures == NULL) {
+            return 0;
+        }
+        results->failures = failures;
+        sizes = (size_t *)realloc(results->sizes, space * sizeof(size_t));
+        if (sizes == NULL) {
+            return 0;
+        }
+        results->sizes = sizes;
+        results->failure_space = space;
+    }
+    results->failures[results->failure_count] = (char *)payload;
+    results->sizes[results->failure_count] = size;
+    results->failure_count++;
+    return 1;
+}
+
+static void send_reporter_passes(TestReporter *reporter) {
+    int passes;
+    LOCK_RESULTS();
+    passes = TAKE_PASSES(&reporter->unsent_passes);
+    if (passes > 0) {
+        send_cgreen_message(reporter->ipc, completion + passes);
+    }
+    UNLOCK_RESULTS();
+}
+
+/* A failure travels as its line, whether it has a message, the file
+   and the formatted message, and is shown by whoever reads it. */
+static void send_reporter_failure(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments) {
+    char *text = (message == NULL ? NULL : format_reporter_message(message, arguments));
+    size_t file_size, text_size, size;
+    char *payload;
+    if (file == NULL) {
+        file = "";
+    }
+    file_size = strlen(file) + 1;
+    text_size = (text == NULL ? 0 : strlen(text) + 1);
+    size = sizeof(int) + 1 + file_size + text_size;
+    payload = (char *)malloc(size);
+    if (payload == NULL) {
+        send_cgreen_message(reporter->ipc, fail);
+        free(text);
+        return;
+    }
+    memcpy(payload, &line, sizeof(int));
+    payload[sizeof(int)] = (text != NULL);
+    memcpy(payload + sizeof(int) + 1, file, file_size);
+    if (text != NULL) {
+        memcpy(payload + sizeof(int) + 1 + file_size, text, text_size);
+    }
+    send_cgreen_message_with_payload(reporter->ipc, fail, payload, size);
+    free(payload);
+    free(text);
+}
+
+/* A failure that came without its details is still shown, as a problem
+   with no place or message */
+static void show_failure_from(TestReporter *reporter, const char *payload, size_t size) {
+    const char *file;
+    const char *text = NULL;
+    int line;
+    if (payload == NULL || size < sizeof(int) + 2 || payload[size - 1] != '\0') {
+        show_failure(reporter, "", 0, NULL);
+        return;
+    }
+    memcpy(&line, payload, sizeof(int));
+    file = payload + sizeof(int) + 1;
+    if (payload[sizeof(int)]) {
+        text = file + strlen(file) + 1;
+    }
+    show_failure(reporter, file, line, (text == NULL ? NULL : "%s"), text);
+}
+
+static void show_failure(TestReporter *reporter, const char *file, int line, const char *message, ...) {
+    va_list arguments;
+    va_start(arguments, message);
+    (*reporter->show_fail)(reporter, file, line, message, arguments);
+    va_end(arguments);
+}
+
 /* vim: set ts=4 sw=4 et cindent: */
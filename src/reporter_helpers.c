@@ -0,0 +1,79 @@
+#include "reporter_helpers.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef va_copy
+#define va_copy(copy, original) ((copy) = (original))
+#endif
+
+/* The text is as long as it needs to be, so the caller frees it */
+char *format_reporter_message(const char *message, va_list arguments) {
+    va_list copy;
+    int length;
+    char *text;
+    va_copy(copy, arguments);
+    length = vsnprintf(NULL, 0, message, copy);
+    va_end(copy);
+    if (length < 0) {
+        return NULL;
+    }
+    text = (char *)malloc(length + 1);
+    if (text != NULL) {
+        vsnprintf(text, length + 1, message, arguments);
+    }
+    return text;
+}
+
+/* Characters that XML 1.0 cannot hold at all, even as references, are
+   shown as question marks */
+void write_xml_escaped(XmlWriter *writer, void *sink, const char *text) {
+    const char *plain = text;
+    const char *replacement;
+    if (text == NULL) {
+        return;
+    }
+    for (; *text != '\0'; text++) {
+        unsigned char c = (unsigned char)*text;
+        switch (c) {
+        case '&': replacement = "&amp;"; break;
+        case '<': replacement = "&lt;"; break;
+        case '>': replacement = "&gt;"; break;
+        case '"': replacement = "&quot;"; break;
+        case '\'': replacement = "&apos;"; break;
+        case '\t': replacement = "&#9;"; break;
+        case '\n': replacement = "&#10;"; break;
+        case '\r': replacement = "&#13;"; break;
+        default: replacement = (c < 0x20 || c == 0x7f) ? "?" : NULL; break;
+        }
+        if (replacement != NULL) {
+            (*writer)(sink, plain, text - plain);
+            (*writer)(sink, replacement, strlen(replacement));
+            plain = text + 1;
+        }
+    }
+    (*writer)(sink, plain, text - plain);
+}
+
+double monotonic_seconds_now() {
+#if defined WINCE || defined WIN32
+    return (double)clock() / CLOCKS_PER_SEC;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+#endif
+}
+
+int64_t wall_clock_nanoseconds_now() {
+#if defined WINCE || defined WIN32
+    return (int64_t)time(NULL) * 1000000000;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+/* vim: set ts=4 sw=4 et cindent: */
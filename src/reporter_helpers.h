@@ -0,0 +1,17 @@
+#ifndef REPORTER_HELPERS_HEADER
+#define REPORTER_HELPERS_HEADER
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Private to the library, for the reporters and the mocks */
+
+typedef void XmlWriter(void *sink, const char *text, size_t size);
+
+char *format_reporter_message(const char *message, va_list arguments);
+void write_xml_escaped(XmlWriter *writer, void *sink, const char *text);
+double monotonic_seconds_now();
+int64_t wall_clock_nanoseconds_now();
+
+#endif
@@ -0,0 +1,416 @@
+#include <cgreen/reporter_output.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#if defined WINCE || defined WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#endif
+
+#ifndef va_copy
+#define va_copy(copy, original) ((copy) = (original))
+#endif
+
+#define OUTPUT_RING_SIZE 65536
+#define FORMAT_BUFFER_SIZE 1024
+
+/* The runner fills the ring from the tail and whoever writes it out
+   empties it from the head, so that with a writer thread the text is
+   handed over without a lock. The lock is only for the writer to sleep
+   on when there is nothing to write, and for the runner to wait on
+   when it wants everything written. Whatever the tests or their set ups
+   left in the stdio buffer of the same file goes out first, wherever the
+   ring is written from. */
+#if defined WINCE || defined WIN32
+#define LOAD_ACQUIRE(pointer) (*(pointer))
+#define STORE_RELEASE(pointer, value) (*(pointer) = (value))
+#else
+#define LOAD_ACQUIRE(pointer) __atomic_load_n(pointer, __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(pointer, value) __atomic_store_n(pointer, value, __ATOMIC_RELEASE)
+#endif
+
+struct ReporterOutput_ {
+    int file_descriptor;
+    int interactive;
+    int shares_stdout;
+    char *ring;
+    unsigned long head;
+    unsigned long tail;
+    struct ReporterOutput_ *next;
+#if !defined WINCE && !defined WIN32
+    int background;
+    int stopping;
+    int sleeping;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t written;
+#endif
+};
+
+static ReporterOutput *outputs = NULL;
+static ReporterOutput *standard_output = NULL;
+#if !defined WINCE && !defined WIN32
+static int fork_handler_installed = 0;
+#endif
+
+static void append(ReporterOutput *output, const char *text, size_t size);
+static void write_out(ReporterOutput *output, unsigned long head, unsigned long tail);
+static void write_all(int file_descriptor, const char *text, size_t size);
+static void flush_stdio_first(ReporterOutput *output);
+static void flush_standard_output_at_exit();
+#if !defined WINCE && !defined WIN32
+static void write_pieces(int file_descriptor, struct iovec *pieces, int count);
+static void *write_in_background(void *output);
+static void forget_writers_in_child();
+#endif
+
+ReporterOutput *create_reporter_output(int file_descriptor) {
+    ReporterOutput *output = (ReporterOutput *)malloc(sizeof(ReporterOutput));
+    if (output == NULL) {
+        return NULL;
+    }
+    output->ring = (char *)malloc(OUTPUT_RING_SIZE);
+    if (output->ring == NULL) {
+        free(output);
+        return NULL;
+    }
+    output->file_descriptor = file_descriptor;
+    output->shares_stdout = (file_descriptor == fileno(stdout));
+#if defined WINCE || defined WIN32
+    output->interactive = _isatty(file_descriptor);
+#else
+    output->interactive = isatty(file_descriptor);
+    output->background = 0;
+    output->stopping = 0;
+    output->sleeping = 0;
+    pthread_mutex_init(&output->lock, NULL);
+    pthread_cond_init(&output->wake, NULL);
+    pthread_cond_init(&output->written, NULL);
+    if (! fork_handler_installed) {
+        pthread_atfork(NULL, NULL, &forget_writers_in_child);
+        fork_handler_installed = 1;
+    }
+#endif
+    output->head = 0;
+    output->tail = 0;
+    output->next = outputs;
+    outputs = output;
+    return output;
+}
+
+void destroy_reporter_output(ReporterOutput *output) {
+    ReporterOutput **link;
+    flush_reporter_output(output);
+#if !defined WINCE && !defined WIN32
+    if (output->background) {
+        pthread_mutex_lock(&output->lock);
+        output->stopping = 1;
+        pthread_cond_signal(&output->wake);
+        pthread_mutex_unlock(&output->lock);
+        pthread_join(output->writer, NULL);
+    }
+    pthread_cond_destroy(&output->written);
+    pthread_cond_destroy(&output->wake);
+    pthread_mutex_destroy(&output->lock);
+#endif
+    for (link = &outputs; *link != NULL; link = &(*link)->next) {
+        if (*link == output) {
+            *link = output->next;
+            break;
+        }
+    }
+    if (output == standard_output) {
+        standard_output = NULL;
+    }
+    free(output->ring);
+    free(output);
+}
+
+/* Without threads the runner writes the text out itself */
+void write_reporter_output_in_background(ReporterOutput *output) {
+#if !defined WINCE && !defined WIN32
+    if (output->background) {
+        return;
+    }
+    output->background = 1;
+    if (pthread_create(&output->writer, NULL, &write_in_background, output) != 0) {
+        output->background = 0;
+    }
+#endif
+}
+
+void reporter_output_write(ReporterOutput *output, const char *text, size_t size) {
+    if (output == NULL) {
+        fwrite(text, 1, size, stdout);
+        return;
+    }
+    append(output, text, size);
+}
+
+void reporter_output_printf(ReporterOutput *output, const char *format, ...) {
+    va_list arguments;
+    va_start(arguments, format);
+    reporter_output_vprintf(output, format, arguments);
+    va_end(arguments);
+}
+
+void reporter_output_vprintf(ReporterOutput *output, const char *format, va_list arguments) {
+    char buffer[FORMAT_BUFFER_SIZE];
+    char *text = buffer;
+    va_list copy;
+    int size;
+    if (output == NULL) {
+        vprintf(format, arguments);
+        return;
+    }
+    va_copy(copy, arguments);
+    size = vsnprintf(buffer, sizeof(buffer), format, copy);
+    va_end(copy);
+    if (size < 0) {
+        return;
+    }
+    if ((size_t)size >= sizeof(buffer)) {
+        text = (char *)malloc(size + 1);
+        if (text == NULL) {
+            return;
+        }
+        vsnprintf(text, size + 1, format, arguments);
+    }
+    append(output, text, size);
+    if (text != buffer) {
+        free(text);
+    }
+}
+
+/* Called at the end of each thing reported. A terminal sees it at once,
+   anything else as the ring fills. */
+void reporter_output_event_done(ReporterOutput *output) {
+    if (output == NULL) {
+        return;
+    }
+#if !defined WINCE && !defined WIN32
+    if (output->background) {
+        /* Waking the writer for every line would cost more than writing
+           it, so a file or pipe is left to fill a quarter of the ring.
+           Only a sleeping writer needs waking, and the fences make sure
+           one that is just going to sleep sees the new tail instead. */
+        if (! output->interactive &&
+                output->tail - LOAD_ACQUIRE(&output->head) < OUTPUT_RING_SIZE / 4) {
+            return;
+        }
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&output->sleeping, __ATOMIC_RELAXED)) {
+            pthread_mutex_lock(&output->lock);
+            pthread_cond_signal(&output->wake);
+            pthread_mutex_unlock(&output->lock);
+        }
+        return;
+    }
+#endif
+    if (output->interactive) {
+        flush_reporter_output(output);
+    }
+}
+
+/* Returns once everything given so far has been written */
+void flush_reporter_output(ReporterOutput *output) {
+    if (output == NULL) {
+        fflush(stdout);
+        return;
+    }
+    flush_stdio_first(output);
+#if !defined WINCE && !defined WIN32
+    if (output->background) {
+        pthread_mutex_lock(&output->lock);
+        pthread_cond_signal(&output->wake);
+        while (output->head != output->tail) {
+            pthread_cond_wait(&output->written, &output->lock);
+        }
+        pthread_mutex_unlock(&output->lock);
+        return;
+    }
+#endif
+    write_out(output, output->head, output->tail);
+    output->head = output->tail;
+}
+
+ReporterOutput *standard_reporter_output() {
+    const char *background;
+    if (standard_output == NULL) {
+        fflush(stdout);
+        standard_output = create_reporter_output(fileno(stdout));
+        if (standard_output == NULL) {
+            return NULL;
+        }
+        background = getenv("CGREEN_OUTPUT_THREAD");
+        if (background != NULL && *background != '\0' && strcmp(background, "0") != 0) {
+            write_reporter_output_in_background(standard_output);
+        }
+        atexit(&flush_standard_output_at_exit);
+    }
+    return standard_output;
+}
+
+int standard_output_printf(const char *format, ...) {
+    va_list arguments;
+    va_start(arguments, format);
+    reporter_output_vprintf(standard_reporter_output(), format, arguments);
+    va_end(arguments);
+    return 0;
+}
+
+void flush_standard_reporter_output() {
+    if (standard_output != NULL) {
+        flush_reporter_output(standard_output);
+    }
+}
+
+/* Text too large for the ring goes straight out after what is queued */
+static void append(ReporterOutput *output, const char *text, size_t size) {
+    unsigned long tail = output->tail;
+    size_t start = tail % OUTPUT_RING_SIZE;
+    size_t first = OUTPUT_RING_SIZE - start;
+    if (size > OUTPUT_RING_SIZE) {
+        flush_reporter_output(output);
+        write_all(output->file_descriptor, text, size);
+        return;
+    }
+    if (OUTPUT_RING_SIZE - (tail - LOAD_ACQUIRE(&output->head)) < size) {
+        flush_reporter_output(output);
+    }
+    if (first > size) {
+        first = size;
+    }
+    memcpy(output->ring + start, text, first);
+    memcpy(output->ring, text + first, size - first);
+    STORE_RELEASE(&output->tail, tail + size);
+}
+
+/* The text may wrap round the end of the ring, so comes in two pieces */
+static void write_out(ReporterOutput *output, unsigned long head, unsigned long tail) {
+    size_t start = head % OUTPUT_RING_SIZE;
+    size_t size = tail - head;
+    size_t first = OUTPUT_RING_SIZE - start;
+#if !defined WINCE && !defined WIN32
+    struct iovec pieces[2];
+#endif
+    if (size == 0) {
+        return;
+    }
+    if (first > size) {
+        first = size;
+    }
+#if defined WINCE || defined WIN32
+    write_all(output->file_descriptor, output->ring + start, first);
+    write_all(output->file_descriptor, output->ring, size - first);
+#else
+    pieces[0].iov_base = output->ring + start;
+    pieces[0].iov_len = first;
+    pieces[1].iov_base = output->ring;
+    pieces[1].iov_len = size - first;
+    write_pieces(output->file_descriptor, pieces, size > first ? 2 : 1);
+#endif
+}
+
+static void write_all(int file_descriptor, const char *text, size_t size) {
+#if defined WINCE || defined WIN32
+    while (size > 0) {
+        int written = _write(file_descriptor, text, (unsigned int)size);
+        if (written <= 0) {
+            return;
+        }
+        text += written;
+        size -= written;
+    }
+#else
+    struct iovec piece;
+    piece.iov_base = (void *)text;
+    piece.iov_len = size;
+    write_pieces(file_descriptor, &piece, 1);
+#endif
+}
+
+static void flush_stdio_first(ReporterOutput *output) {
+    if (output->shares_stdout) {
+        fflush(stdout);
+    }
+}
+
+static void flush_standard_output_at_exit() {
+    flush_standard_reporter_output();
+}
+
+#if !defined WINCE && !defined WIN32
+static void write_pieces(int file_descriptor, struct iovec *pieces, int count) {
+    while (count > 0) {
+        ssize_t written = writev(file_descriptor, pieces, count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        while (count > 0 && (size_t)written >= pieces->iov_len) {
+            written -= pieces->iov_len;
+            pieces++;
+            count--;
+        }
+        if (count > 0) {
+            pieces->iov_base = (char *)pieces->iov_base + written;
+            pieces->iov_len -= written;
+        }
+    }
+}
+
+static void *write_in_background(void *abstract) {
+    ReporterOutput *output = (ReporterOutput *)abstract;
+    unsigned long head;
+    unsigned long tail;
+    pthread_mutex_lock(&output->lock);
+    for (;;) {
+        head = output->head;
+        tail = LOAD_ACQUIRE(&output->tail);
+        if (head != tail) {
+            pthread_mutex_unlock(&output->lock);
+            flush_stdio_first(output);
+            write_out(output, head, tail);
+            pthread_mutex_lock(&output->lock);
+            STORE_RELEASE(&output->head, tail);
+            pthread_cond_broadcast(&output->written);
+        } else if (output->stopping) {
+            break;
+        } else {
+            __atomic_store_n(&output->sleeping, 1, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if (LOAD_ACQUIRE(&output->tail) == head) {
+                pthread_cond_wait(&output->wake, &output->lock);
+            }
+            __atomic_store_n(&output->sleeping, 0, __ATOMIC_RELAXED);
+        }
+    }
+    pthread_mutex_unlock(&output->lock);
+    return NULL;
+}
+
+/* A forked child has no writer threads, and what is still queued is
+   the parent's to write */
+static void forget_writers_in_child() {
+    ReporterOutput *output;
+    for (output = outputs; output != NULL; output = output->next) {
+        output->background = 0;
+        output->stopping = 0;
+        output->sleeping = 0;
+        output->head = output->tail;
+        pthread_mutex_init(&output->lock, NULL);
+        pthread_cond_init(&output->wake, NULL);
+        pthread_cond_init(&output->written, NULL);
+    }
+}
+#endif
+
+/* vim: set ts=4 sw=4 et cindent: */
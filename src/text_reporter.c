@@ -1,9 +1,16 @@
 #include <cgreen/text_reporter.h>
 #include <cgreen/reporter.h>
 #include <cgreen/breadcrumb.h>
+#include <cgreen/reporter_output.h>
 #include <stdlib.h>
 #include <stdio.h>
 
+/* Counts the breadcrumbs shown, so that the outermost can be left out */
+typedef struct {
+    ReporterOutput *output;
+    int depth;
+} BreadcrumbWalk;
+
 static void text_reporter_start_suite(TestReporter *reporter, const char *name, const int number_of_tests);
 static void text_reporter_start_test(TestReporter *reporter, const char *name);
 static void text_reporter_finish(TestReporter *reporter, const char *name);
@@ -25,6 +32,7 @@ TestReporter *create_text_reporter(void) {
 #endif
     reporter->finish_test = &text_reporter_finish;
     reporter->finish_suite = &text_reporter_finish;
+    reporter->reporter_context = standard_reporter_output();
     return reporter;
 }
 
@@ -34,8 +42,10 @@ static void text_reporter_start_suite(TestReporter *reporter, const char *name,
 #ifdef CG_FILE_LOG
         fprintf(reporter->fOutput, "Running \"%s\"...\n", get_current_from_breadcrumb((CgreenBreadcrumb *)reporter->breadcrumb));
 #endif
-		printf("Running \"%s\"...\n",
+		reporter_output_printf((ReporterOutput *)reporter->reporter_context,
+		       "Running \"%s\"...\n",
 		       get_current_from_breadcrumb((CgreenBreadcrumb *)reporter->breadcrumb));
+		reporter_output_event_done((ReporterOutput *)reporter->reporter_context);
 	}
 }
 
@@ -58,7 +68,8 @@ static void text_reporter_finish(TestReporter *reporter, const char *name) {
 				reporter->exceptions == 1 ? "" : "s");
 		fclose(reporter->fOutput);
 #endif
-		printf(
+		reporter_output_printf(
+				(ReporterOutput *)reporter->reporter_context,
 				"Completed \"%s\": %d pass%s, %d failure%s, %d exception%s.\n",
 				name,
 				reporter->passes,
@@ -67,48 +78,54 @@ static void text_reporter_finish(TestReporter *reporter, const char *name) {
 				reporter->failures == 1 ? "" : "s",
 				reporter->exceptions,
 				reporter->exceptions == 1 ? "" : "s");
+		flush_reporter_output((ReporterOutput *)reporter->reporter_context);
 	}
 }
 
 static void show_fail(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments) {
-    int i = 0;
+    ReporterOutput *output = (ReporterOutput *)reporter->reporter_context;
+    BreadcrumbWalk walk = {output, 0};
 #ifdef CG_FILE_LOG
     fprintf(reporter->fOutput, "%s:%d: unit test failure: ", file, line);
 #endif
-    printf("%s:%d: unit test failure: ", file, line);
+    reporter_output_printf(output, "%s:%d: unit test failure: ", file, line);
     walk_breadcrumb(
             (CgreenBreadcrumb *)reporter->breadcrumb,
             &show_breadcrumb,
-            (void *)&i);
+            (void *)&walk);
 #ifdef CG_FILE_LOG
     vfprintf(reporter->fOutput, (message == NULL ? "Problem" : message), arguments);
     fprintf(reporter->fOutput, " at [%s] line [%d]\n\n", file, line);
 #endif
-    vprintf((message == NULL ? "Problem" : message), arguments);
-    printf(" at [%s] line [%d]\n", file, line);
+    reporter_output_vprintf(output, (message == NULL ? "Problem" : message), arguments);
+    reporter_output_printf(output, " at [%s] line [%d]\n", file, line);
+    reporter_output_event_done(output);
 }
 
 static void show_incomplete(TestReporter *reporter, const char *name) {
-    int i = 0;
+    ReporterOutput *output = (ReporterOutput *)reporter->reporter_context;
+    BreadcrumbWalk walk = {output, 0};
 #ifdef CG_FILE_LOG
     fprintf(reporter->fOutput, "Exception!: ");
 #endif
-    printf("Exception!: ");
+    reporter_output_printf(output, "Exception!: ");
     walk_breadcrumb(
             (CgreenBreadcrumb *)reporter->breadcrumb,
             &show_breadcrumb,
-            (void *)&i);
+            (void *)&walk);
 #ifdef CG_FILE_LOG
     fprintf(reporter->fOutput, "Test \"%s\" failed to complete\n\n", name);
 #endif
-    printf("Test \"%s\" failed to complete\n", name);
+    reporter_output_printf(output, "Test \"%s\" failed to complete\n", name);
+    reporter_output_event_done(output);
 }
 
 static void show_breadcrumb(const char *name, void *memo) {
-    if (*(int *)memo > 0) {
-        printf("%s -> ", name);
+    BreadcrumbWalk *walk = (BreadcrumbWalk *)memo;
+    if (walk->depth > 0) {
+        reporter_output_printf(walk->output, "%s -> ", name);
     }
-    (*(int *)memo)++;
+    walk->depth++;
 }
 
 /* vim: set ts=4 sw=4 et cindent: */
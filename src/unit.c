@@ -1,8 +1,12 @@
 #include <cgreen/unit.h>
 #include <cgreen/reporter.h>
+#include <cgreen/messaging.h>
 #include <cgreen/mocks.h>
 #include <cgreen/parameters.h>
 #include <cgreen/assertions.h>
+#include <cgreen/breadcrumb.h>
+#include <cgreen/vector.h>
+#include <cgreen/reporter_output.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -26,6 +30,13 @@
 #else
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <setjmp.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
 
 #endif
@@ -58,8 +69,36 @@ struct TestSuite_ {
     void (*setup)();
     void (*teardown)();
     int size;
+    int forks;
 };
 
+/* Every suite and test below the one being run, in running order and
+   named by their path of suite names, as in "suite/test". An entry
+   covers the tests from first up to last, counted in running order,
+   and the entries inside a suite stop short of its end. Paths and bare
+   names are both hashed, with entries sharing a bucket chained on. */
+typedef struct {
+    int type;
+    char *path;
+    const char *name;
+    int first;
+    int last;
+    int end;
+    int next_in_path_bucket;
+    int next_in_name_bucket;
+} IndexEntry;
+
+typedef struct {
+    IndexEntry *entries;
+    int size;
+    int capacity;
+    int tests;
+    int *paths;
+    int *names;
+    unsigned int buckets;
+    const char *root;
+} TestIndex;
+
 #if defined WIN32 || defined IPHONE
 typedef struct
 {
@@ -67,18 +106,189 @@ typedef struct
     UnitTest *test;
     TestReporter *reporter;
 } CgTestParams;
+#else
+#define CRASH_SIGNAL_COUNT 5
+#define SIGNAL_STACK_SIZE (SIGSTKSZ < 65536 ? 65536 : SIGSTKSZ)
+
+/* What a run of tests in the current process replaced, so that runs can
+   be nested and the caller gets its own handlers back afterwards. */
+typedef struct {
+    struct sigaction actions[CRASH_SIGNAL_COUNT];
+    stack_t stack;
+    void *stack_memory;
+    sigjmp_buf recovery;
+    int armed;
+} CrashRecovery;
+
+enum {suite_start, test_run, suite_finish};
+
+/* Batches of quick tests grow until a process lasts about this long */
+#define MOST_TESTS_PER_PROCESS 256
+#define SECONDS_PER_PROCESS 0.02
+
+/* The suite tree flattened into reporting order. Each test step keeps
+   whatever its process produced until every earlier step is reported. */
+typedef struct {
+    int type;
+    TestSuite *suite;
+    UnitTest *test;
+    int parent;
+    int count;
+    int done;
+    CgreenVector *results;
+    char *output;
+    size_t output_size;
+    TestMetrics metrics;
+} RunStep;
+
+/* A result as the test process sent it, kept until it can be replayed */
+typedef struct {
+    int result;
+    void *payload;
+    size_t size;
+} HeldResult;
+
+/* Written by a test process into shared memory for each test it gets
+   through, as a process can run several. */
+typedef struct {
+    long end;
+    TestMetrics metrics;
+} FinishedTest;
+
+/* Each worker owns a contiguous run of tests, taken from the front.
+   An idle worker steals the back half of the busiest one. A process
+   runs the tests from first up to last, and writes down in the shared
+   finished where its captured output stood after each one. */
+typedef struct {
+    int head;
+    int tail;
+    int busy;
+    pid_t pid;
+    int first;
+    int last;
+    struct timespec started;
+    FinishedTest *finished;
+    int ipc;
+    FILE *output;
+    int runs;
+    int processes;
+    int steals;
+} Worker;
+
+typedef struct {
+    RunStep *steps;
+    int step_count;
+    int *tests;
+    int test_count;
+    Worker *workers;
+    int jobs;
+    int running;
+    int reported;
+    int trace;
+    int batch;
+    double seconds_per_test;
+    FinishedTest *finished;
+    pid_t fork_server;
+    int requests;
+    int completions;
+} TestSchedule;
+
+/* With a fork server the runner never forks the tests itself. It asks a
+   process forked before any results were collected to do it instead. */
+typedef struct {
+    int worker;
+    int first;
+    int last;
+} TestRequest;
+
+typedef struct {
+    int worker;
+    int status;
+    struct rusage usage;
+} TestCompletion;
 #endif
 
 static void clean_up_test_run(TestSuite *suite, TestReporter *reporter);
 static void run_every_test(TestSuite *suite, TestReporter *reporter);
-static void run_named_test(TestSuite *suite, char *name, TestReporter *reporter);
-static int has_test(TestSuite *suite, char *name);
+static void run_every_test_in_process(TestSuite *suite, TestReporter *reporter);
+static void run_chosen_tests(TestSuite *suite, TestIndex *index, const int *chosen_before, int *entry, TestReporter *reporter);
+static TestIndex *create_test_index(TestSuite *suite);
+static void destroy_test_index(TestIndex *index);
+static void index_suite(TestIndex *index, TestSuite *suite, const char *path);
+static int add_index_entry(TestIndex *index, int type, const char *path, const char *name);
+static int hash_index(TestIndex *index);
+static unsigned int hash_of(const char *key, size_t length);
+static int select_tests(TestIndex *index, const char *selection, char *chosen);
+static int select_tests_below_root(TestIndex *index, const char *selection, char *chosen);
+static int select_by_path(TestIndex *index, const char *path, size_t length, int type, char *chosen);
+static int select_by_name(TestIndex *index, const char *name, char *chosen);
+static int select_by_glob(TestIndex *index, const char *pattern, char *chosen);
+static int choose_entry(IndexEntry *entry, char *chosen);
+static int matches_glob(const char *pattern, const char *text);
 static void run_test_in_the_current_process(TestSuite *suite, UnitTest *test, TestReporter *reporter);
 static void run_test_in_its_own_process(TestSuite *suite, UnitTest *test, TestReporter *reporter);
 
-#ifndef WIN32
+#if !defined(WIN32) && !defined(IPHONE)
 static int in_child_process();
-static void wait_for_child_process();
+static void wait_for_child_process(struct rusage *usage);
+static void measure_test(TestMetrics *metrics, const struct timespec *started, const struct rusage *before, const struct rusage *after);
+static double seconds_between(const struct timespec *from, const struct timespec *to);
+static double seconds_of(const struct timeval *time);
+#endif
+
+static int jobs_from_environment();
+static int in_process_from_environment();
+
+#if !defined(WIN32) && !defined(IPHONE)
+static CrashRecovery *start_crash_recovery();
+static void stop_crash_recovery(CrashRecovery *previous);
+static void recover_from_crash(int signal_number);
+static void time_out(int signal_number);
+#endif
+
+#if !defined(WIN32) && !defined(IPHONE)
+static TestSchedule *create_test_schedule(TestSuite *suite, int jobs);
+static void destroy_test_schedule(TestSchedule *schedule);
+static int add_suite_steps(TestSchedule *schedule, TestSuite *suite, int parent);
+static int add_step(TestSchedule *schedule, int type, TestSuite *suite, UnitTest *test, int parent);
+static int create_workers(TestSchedule *schedule, int jobs);
+static void run_schedule(TestSchedule *schedule, TestReporter *reporter);
+static int take_tests_for(TestSchedule *schedule, int worker);
+static int busiest_worker(TestSchedule *schedule);
+static void launch_tests(TestSchedule *schedule, int worker, TestReporter *reporter);
+static void run_tests_in_worker(TestSchedule *schedule, Worker *worker, TestReporter *reporter);
+static void run_test_in_worker(TestSchedule *schedule, Worker *worker, int test, TestReporter *reporter);
+static void start_enclosing_suites(TestSchedule *schedule, int start, TestReporter *reporter);
+static int end_of_fixture(TestSchedule *schedule, int begin);
+static void deal_tests(TestSchedule *schedule, int begin, int end);
+static int enclosing_fixture(TestSchedule *schedule, int step);
+static int is_fixture_boundary(TestSchedule *schedule, RunStep *step);
+static void run_fixture(TestSchedule *schedule, int parent, int type);
+static void call_fixture(TestSuite *suite, int type);
+static int has_fixture(TestSuite *suite);
+static void wait_for_any_worker(TestSchedule *schedule);
+static void wait_for_any_test_process(TestSchedule *schedule);
+static void wait_for_fork_server(TestSchedule *schedule);
+static int start_fork_server(TestSchedule *schedule, TestReporter *reporter);
+static void stop_fork_server(TestSchedule *schedule);
+static void serve_test_processes(TestSchedule *schedule, TestReporter *reporter, int requests, int completions);
+static void fork_test_for_request(TestSchedule *schedule, TestReporter *reporter, TestRequest *request);
+static void run_fixture_for_request(TestSchedule *schedule, TestRequest *request, int completions);
+static void report_completed_test_processes(TestSchedule *schedule, int completions);
+static void wake_fork_server(int signal_number);
+static int fork_server_from_environment();
+static int batch_size_from_environment();
+static void collect_results(TestSchedule *schedule, Worker *worker, const struct rusage *usage);
+static HeldResult *receive_held_result(int messaging);
+static void destroy_held_result(void *held);
+static void time_batch(TestSchedule *schedule, Worker *worker, int tests);
+static void measure_crashed_test(RunStep *step, Worker *worker, const struct rusage *usage, int completed);
+static char *read_captured_output(FILE *output, size_t *size);
+static char *copy_output(const char *output, size_t start, size_t end, size_t *size);
+static void report_finished_steps(TestSchedule *schedule, TestReporter *reporter);
+static void report_step(RunStep *step, TestReporter *reporter);
+static void report_test_step(RunStep *step, TestReporter *reporter);
+static void show_schedule_trace(TestSchedule *schedule);
 #endif
 
 static void ignore_ctrl_c();
@@ -89,6 +299,12 @@ static void tally_counter(const char *file, int line, int expected, int actual,
 static void die(const char *message, ...);
 static void do_nothing();
 
+#if !defined(WIN32) && !defined(IPHONE)
+static const int crash_signals[CRASH_SIGNAL_COUNT] = {SIGSEGV, SIGBUS, SIGFPE, SIGABRT, SIGILL};
+static sigjmp_buf crash_recovery;
+static volatile sig_atomic_t crash_recovery_armed = 0;
+#endif
+
 TestSuite *create_named_test_suite(const char *name) {
     TestSuite *suite = (TestSuite *)malloc(sizeof(TestSuite));
 	suite->name = name;
@@ -96,6 +312,7 @@ TestSuite *create_named_test_suite(const char *name) {
     suite->setup = &do_nothing;
     suite->teardown = &do_nothing;
     suite->size = 0;
+    suite->forks = 0;
     return suite;
 }
 
@@ -151,9 +368,13 @@ void teardown_(TestSuite *suite, void (*teardown)()) {
     suite->teardown = teardown;
 }
 
+void always_fork_tests(TestSuite *suite) {
+    suite->forks = 1;
+}
+
 #if !defined(WIN32) && !defined(IPHONE)
 void die_in(unsigned int seconds) {
-    signal(SIGALRM, (sighandler_t)&stop);
+    signal(SIGALRM, (sighandler_t)&time_out);
     alarm(seconds);
 }
 #endif
@@ -172,31 +393,134 @@ int count_tests(TestSuite *suite) {
 }
 
 int run_test_suite(TestSuite *suite, TestReporter *reporter) {
+    if (in_process_from_environment()) {
+        return run_test_suite_in_process(suite, reporter);
+    }
+    return run_test_suite_parallel(suite, reporter, jobs_from_environment());
+}
+
+int run_test_suite_parallel(TestSuite *suite, TestReporter *reporter, int jobs) {
+    int success = 0;
+#if !defined(WIN32) && !defined(IPHONE)
+    TestSchedule *schedule = NULL;
+#endif
+    if (reporter == NULL) {
+        return EXIT_FAILURE;
+    }
+    success = setup_reporting(reporter);
+    if (success < 0) {
+        (*reporter->destroy)(reporter);
+        return EXIT_FAILURE;
+    }
+#if !defined(WIN32) && !defined(IPHONE)
+    if (jobs > 1 || fork_server_from_environment() || batch_size_from_environment() > 1) {
+        schedule = create_test_schedule(suite, jobs > 1 ? jobs : 1);
+    }
+    if (schedule != NULL) {
+        if (fork_server_from_environment() && ! start_fork_server(schedule, reporter)) {
+            die("Could not start the fork server\n");
+        }
+        run_schedule(schedule, reporter);
+        stop_fork_server(schedule);
+        destroy_test_schedule(schedule);
+    } else {
+        run_every_test(suite, reporter);
+    }
+#else
+    (void)jobs;
+    run_every_test(suite, reporter);
+#endif
+    success = (reporter->failures == 0 && reporter->exceptions == 0);
+    clean_up_test_run(suite, reporter);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int run_test_suite_in_process(TestSuite *suite, TestReporter *reporter) {
     int success = 0;
+#if !defined(WIN32) && !defined(IPHONE)
+    CrashRecovery *previous;
+#endif
     if (reporter == NULL) {
         return EXIT_FAILURE;
     }
     success = setup_reporting(reporter);
     if (success < 0) {
+        (*reporter->destroy)(reporter);
         return EXIT_FAILURE;
     }
+#if !defined(WIN32) && !defined(IPHONE)
+    previous = start_crash_recovery();
+    if (previous == NULL) {
+        die("Could not install the crash handlers\n");
+    }
+    if (suite->forks) {
+        run_every_test(suite, reporter);
+    } else {
+        run_every_test_in_process(suite, reporter);
+    }
+    stop_crash_recovery(previous);
+#else
     run_every_test(suite, reporter);
+#endif
     success = (reporter->failures == 0 && reporter->exceptions == 0);
     clean_up_test_run(suite, reporter);
     return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 int run_single_test(TestSuite *suite, char *name, TestReporter *reporter) {
+    return run_selected_tests(suite, &name, 1, reporter);
+}
+
+int run_selected_tests(TestSuite *suite, char **selections, int count, TestReporter *reporter) {
     int success = 0;
+    TestIndex *index;
+    char *chosen;
+    int *chosen_before;
+    int entry = 0;
+    int unmatched = 0;
+    int i;
+#if !defined(WIN32) && !defined(IPHONE)
+    CrashRecovery *previous;
+#endif
     if (reporter == NULL) {
         return EXIT_FAILURE;
     }
     success = setup_reporting(reporter);
     if (success < 0) {
+        (*reporter->destroy)(reporter);
         return EXIT_FAILURE;
     }
-    run_named_test(suite, name, reporter);
-    success = (reporter->failures == 0 && reporter->exceptions == 0);
+    index = create_test_index(suite);
+    chosen = (char *)calloc(index->tests + 1, sizeof(char));
+    chosen_before = (int *)malloc(sizeof(int) * (index->tests + 1));
+    if (chosen == NULL || chosen_before == NULL) {
+        die("Could not select the tests to run\n");
+    }
+    for (i = 0; i < count; i++) {
+        if (select_tests(index, selections[i], chosen) == 0) {
+            flush_standard_reporter_output();
+            printf("No tests match \"%s\"\n", selections[i]);
+            unmatched++;
+        }
+    }
+    chosen_before[0] = 0;
+    for (i = 0; i < index->tests; i++) {
+        chosen_before[i + 1] = chosen_before[i] + chosen[i];
+    }
+#if !defined(WIN32) && !defined(IPHONE)
+    previous = start_crash_recovery();
+    if (previous == NULL) {
+        die("Could not install the crash handlers\n");
+    }
+    run_chosen_tests(suite, index, chosen_before, &entry, reporter);
+    stop_crash_recovery(previous);
+#else
+    run_chosen_tests(suite, index, chosen_before, &entry, reporter);
+#endif
+    free(chosen_before);
+    free(chosen);
+    destroy_test_index(index);
+    success = (reporter->failures == 0 && reporter->exceptions == 0 && unmatched == 0);
     clean_up_test_run(suite, reporter);
     return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -223,18 +547,20 @@ static void run_every_test(TestSuite *suite, TestReporter *reporter) {
     (*reporter->finish_suite)(reporter, suite->name);
 }
 
-static void run_named_test(TestSuite *suite, char *name, TestReporter *reporter) {
+static void run_every_test_in_process(TestSuite *suite, TestReporter *reporter) {
     int i = 0;
 
     (*reporter->start_suite)(reporter, suite->name, count_tests(suite));
     for (i = 0; i < suite->size; i++) {
         if (suite->tests[i].type == test_function) {
-            if (strcmp(suite->tests[i].name, name) == 0) {
-                run_test_in_the_current_process(suite, &(suite->tests[i]), reporter);
-            }
-        } else if (has_test(suite->tests[i].sPtr.suite, name)) {
+            run_test_in_the_current_process(suite, &(suite->tests[i]), reporter);
+        } else if (suite->tests[i].sPtr.suite->forks) {
             (*suite->setup)();
-            run_named_test(suite->tests[i].sPtr.suite, name, reporter);
+            run_every_test(suite->tests[i].sPtr.suite, reporter);
+            (*suite->teardown)();
+        } else {
+            (*suite->setup)();
+            run_every_test_in_process(suite->tests[i].sPtr.suite, reporter);
             (*suite->teardown)();
         }
     }
@@ -242,24 +568,274 @@ static void run_named_test(TestSuite *suite, char *name, TestReporter *reporter)
     (*reporter->finish_suite)(reporter, suite->name);
 }
 
-static int has_test(TestSuite *suite, char *name) {
-	int i;
-	for (i = 0; i < suite->size; i++) {
-        if (suite->tests[i].type == test_function) {
-            if (strcmp(suite->tests[i].name, name) == 0) {
-                return 1;
-            }
-        } else if (has_test(suite->tests[i].sPtr.suite, name)) {
-            return 1;
+static void run_chosen_tests(TestSuite *suite, TestIndex *index, const int *chosen_before, int *entry, TestReporter *reporter) {
+    IndexEntry *own = &index->entries[*entry];
+    int i = 0;
+
+    (*reporter->start_suite)(reporter, suite->name, chosen_before[own->last] - chosen_before[own->first]);
+    (*entry)++;
+    for (i = 0; i < suite->size; i++) {
+        IndexEntry *child = &index->entries[*entry];
+        if (chosen_before[child->last] == chosen_before[child->first]) {
+            *entry = child->end;
+        } else if (suite->tests[i].type == test_function) {
+            run_test_in_the_current_process(suite, &(suite->tests[i]), reporter);
+            (*entry)++;
+        } else {
+            (*suite->setup)();
+            run_chosen_tests(suite->tests[i].sPtr.suite, index, chosen_before, entry, reporter);
+            (*suite->teardown)();
         }
-	}
-	return 0;
+    }
+    send_reporter_completion_notification(reporter);
+    (*reporter->finish_suite)(reporter, suite->name);
+}
+
+static TestIndex *create_test_index(TestSuite *suite) {
+    TestIndex *index = (TestIndex *)malloc(sizeof(TestIndex));
+    int root;
+    if (index == NULL) {
+        die("Could not index the tests\n");
+    }
+    index->entries = NULL;
+    index->size = 0;
+    index->capacity = 0;
+    index->tests = 0;
+    index->paths = NULL;
+    index->names = NULL;
+    index->root = (suite->name == NULL ? "" : suite->name);
+    root = add_index_entry(index, test_suite, "", "");
+    index_suite(index, suite, "");
+    index->entries[root].last = index->tests;
+    index->entries[root].end = index->size;
+    if (! hash_index(index)) {
+        die("Could not index the tests\n");
+    }
+    return index;
+}
+
+static void destroy_test_index(TestIndex *index) {
+    int i;
+    for (i = 0; i < index->size; i++) {
+        free(index->entries[i].path);
+    }
+    free(index->entries);
+    free(index->paths);
+    free(index->names);
+    free(index);
+}
+
+static void index_suite(TestIndex *index, TestSuite *suite, const char *path) {
+    int i;
+    for (i = 0; i < suite->size; i++) {
+        UnitTest *test = &(suite->tests[i]);
+        int entry;
+        if (test->type == test_function) {
+            entry = add_index_entry(index, test_function, path, test->name);
+            index->tests++;
+        } else {
+            entry = add_index_entry(index, test_suite, path, test->sPtr.suite->name);
+            index_suite(index, test->sPtr.suite, index->entries[entry].path);
+        }
+        index->entries[entry].last = index->tests;
+        index->entries[entry].end = index->size;
+    }
+}
+
+static int add_index_entry(TestIndex *index, int type, const char *path, const char *name) {
+    IndexEntry *entry;
+    size_t length = strlen(path);
+    if (index->size == index->capacity) {
+        int capacity = index->capacity == 0 ? 64 : index->capacity * 2;
+        IndexEntry *entries = (IndexEntry *)realloc(index->entries, sizeof(IndexEntry) * capacity);
+        if (entries == NULL) {
+            die("Could not index the tests\n");
+        }
+        index->entries = entries;
+        index->capacity = capacity;
+    }
+    entry = &index->entries[index->size];
+    entry->type = type;
+    entry->path = (char *)malloc(length + strlen(name) + 2);
+    if (entry->path == NULL) {
+        die("Could not index the tests\n");
+    }
+    if (length == 0) {
+        strcpy(entry->path, name);
+    } else {
+        sprintf(entry->path, "%s/%s", path, name);
+        length++;
+    }
+    entry->name = entry->path + length;
+    entry->first = entry->last = index->tests;
+    entry->end = index->size + 1;
+    entry->next_in_path_bucket = entry->next_in_name_bucket = -1;
+    return index->size++;
+}
+
+static int hash_index(TestIndex *index) {
+    unsigned int mask;
+    int i;
+    index->buckets = 16;
+    while (index->buckets < 2 * (unsigned int)index->size) {
+        index->buckets *= 2;
+    }
+    index->paths = (int *)malloc(sizeof(int) * index->buckets);
+    index->names = (int *)malloc(sizeof(int) * index->buckets);
+    if (index->paths == NULL || index->names == NULL) {
+        return 0;
+    }
+    memset(index->paths, -1, sizeof(int) * index->buckets);
+    memset(index->names, -1, sizeof(int) * index->buckets);
+    mask = index->buckets - 1;
+    for (i = index->size - 1; i > 0; i--) {
+        IndexEntry *entry = &index->entries[i];
+        unsigned int path = hash_of(entry->path, strlen(entry->path)) & mask;
+        unsigned int name = hash_of(entry->name, strlen(entry->name)) & mask;
+        entry->next_in_path_bucket = index->paths[path];
+        index->paths[path] = i;
+        entry->next_in_name_bucket = index->names[name];
+        index->names[name] = i;
+    }
+    return 1;
+}
+
+static unsigned int hash_of(const char *key, size_t length) {
+    unsigned int hash = 2166136261u;
+    size_t i;
+    for (i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)key[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/* Paths leave out the suite being run, but one that starts with its name
+   is taken to mean the same path below it when nothing else matches */
+static int select_tests(TestIndex *index, const char *selection, char *chosen) {
+    size_t root = strlen(index->root);
+    int found = select_tests_below_root(index, selection, chosen);
+    if (found == 0 && root > 0 && strncmp(selection, index->root, root) == 0 && selection[root] == '/') {
+        if (selection[root + 1] == '\0') {
+            return choose_entry(&index->entries[0], chosen);
+        }
+        found = select_tests_below_root(index, selection + root + 1, chosen);
+    }
+    return found;
+}
+
+/* A selection with a wildcard is matched against the paths of tests, or
+   their bare names when it has no slash. One ending in a slash picks a
+   whole suite. Anything else is a path, or a bare name that picks every
+   test or suite of that name. */
+static int select_tests_below_root(TestIndex *index, const char *selection, char *chosen) {
+    size_t length = strlen(selection);
+    if (strpbrk(selection, "*?") != NULL) {
+        return select_by_glob(index, selection, chosen);
+    }
+    if (length > 0 && selection[length - 1] == '/') {
+        return select_by_path(index, selection, length - 1, test_suite, chosen);
+    }
+    if (strchr(selection, '/') == NULL) {
+        return select_by_name(index, selection, chosen);
+    }
+    return select_by_path(index, selection, length, -1, chosen);
+}
+
+static int select_by_path(TestIndex *index, const char *path, size_t length, int type, char *chosen) {
+    int found = 0;
+    int i = index->paths[hash_of(path, length) & (index->buckets - 1)];
+    for (; i >= 0; i = index->entries[i].next_in_path_bucket) {
+        IndexEntry *entry = &index->entries[i];
+        if ((type < 0 || entry->type == type) &&
+                strncmp(entry->path, path, length) == 0 && entry->path[length] == '\0') {
+            found += choose_entry(entry, chosen);
+        }
+    }
+    return found;
+}
+
+static int select_by_name(TestIndex *index, const char *name, char *chosen) {
+    int found = 0;
+    int i = index->names[hash_of(name, strlen(name)) & (index->buckets - 1)];
+    for (; i >= 0; i = index->entries[i].next_in_name_bucket) {
+        if (strcmp(index->entries[i].name, name) == 0) {
+            found += choose_entry(&index->entries[i], chosen);
+        }
+    }
+    return found;
+}
+
+static int select_by_glob(TestIndex *index, const char *pattern, char *chosen) {
+    int by_path = (strchr(pattern, '/') != NULL);
+    int found = 0;
+    int i;
+    for (i = 1; i < index->size; i++) {
+        IndexEntry *entry = &index->entries[i];
+        if (entry->type == test_function &&
+                matches_glob(pattern, by_path ? entry->path : entry->name)) {
+            found += choose_entry(entry, chosen);
+        }
+    }
+    return found;
+}
+
+static int choose_entry(IndexEntry *entry, char *chosen) {
+    int i;
+    for (i = entry->first; i < entry->last; i++) {
+        chosen[i] = 1;
+    }
+    return entry->last - entry->first;
+}
+
+static int matches_glob(const char *pattern, const char *text) {
+    const char *star = NULL;
+    const char *resume = NULL;
+    while (*text != '\0') {
+        if (*pattern == '*') {
+            star = pattern++;
+            resume = text;
+        } else if (*pattern == '?' || *pattern == *text) {
+            pattern++;
+            text++;
+        } else if (star != NULL) {
+            pattern = star + 1;
+            text = ++resume;
+        } else {
+            return 0;
+        }
+    }
+    while (*pattern == '*') {
+        pattern++;
+    }
+    return *pattern == '\0';
 }
 
 static void run_test_in_the_current_process(TestSuite *suite, UnitTest *test, TestReporter *reporter) {
+#if !defined(WIN32) && !defined(IPHONE)
+    struct timespec started;
+    struct rusage before, after;
+    TestMetrics metrics;
+#endif
     (*reporter->start_test)(reporter, test->name);
+    flush_standard_reporter_output();
+#if !defined(WIN32) && !defined(IPHONE)
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    getrusage(RUSAGE_SELF, &before);
+    if (sigsetjmp(crash_recovery, 1) == 0) {
+        crash_recovery_armed = 1;
+        run_the_test_code(suite, test, reporter);
+        crash_recovery_armed = 0;
+        send_reporter_completion_notification(reporter);
+    }
+    alarm(0);
+    getrusage(RUSAGE_SELF, &after);
+    measure_test(&metrics, &started, &before, &after);
+    (*reporter->record_metrics)(reporter, test->name, &metrics);
+#else
     run_the_test_code(suite, test, reporter);
     send_reporter_completion_notification(reporter);
+#endif
+    fflush(stdout);
     (*reporter->finish_test)(reporter, test->name);
 }
 
@@ -308,6 +884,8 @@ static void run_test_in_its_own_process(TestSuite *suite, UnitTest *test, TestRe
 #elif defined IPHONE
 	pthread_t thread;
 	pthread_attr_t attr;
+#else
+    struct timespec started;
 #endif
 
 #if defined WIN32 || defined IPHONE
@@ -338,35 +916,815 @@ static void run_test_in_its_own_process(TestSuite *suite, UnitTest *test, TestRe
     pthread_join(thread, NULL);
     (*reporter->finish_test)(reporter, test->name);
 #else
+    clock_gettime(CLOCK_MONOTONIC, &started);
     if (in_child_process()) {
         run_the_test_code(suite, test, reporter);
         send_reporter_completion_notification(reporter);
         stop();
     } else {
-        wait_for_child_process();
+        struct rusage usage;
+        TestMetrics metrics;
+        wait_for_child_process(&usage);
+        measure_test(&metrics, &started, NULL, &usage);
+        (*reporter->record_metrics)(reporter, test->name, &metrics);
         (*reporter->finish_test)(reporter, test->name);
     }
 #endif
 }
 
 #if !defined(WIN32) && !defined(IPHONE)
+static int fork_server_wake_up = -1;
+
+static TestSchedule *create_test_schedule(TestSuite *suite, int jobs) {
+    TestSchedule *schedule = (TestSchedule *)calloc(1, sizeof(TestSchedule));
+    if (schedule == NULL) {
+        return NULL;
+    }
+    schedule->trace = (getenv("CGREEN_TRACE") != NULL);
+    schedule->batch = batch_size_from_environment();
+    if (add_suite_steps(schedule, suite, -1) < 0 || ! create_workers(schedule, jobs)) {
+        destroy_test_schedule(schedule);
+        return NULL;
+    }
+    return schedule;
+}
+
+static void destroy_test_schedule(TestSchedule *schedule) {
+    int i;
+    for (i = 0; i < schedule->step_count; i++) {
+        if (schedule->steps[i].results != NULL) {
+            destroy_cgreen_vector(schedule->steps[i].results);
+        }
+        free(schedule->steps[i].output);
+    }
+    for (i = 0; i < schedule->jobs; i++) {
+        if (schedule->workers[i].output != NULL) {
+            fclose(schedule->workers[i].output);
+        }
+    }
+    if (schedule->finished != NULL) {
+        munmap(schedule->finished, sizeof(FinishedTest) * MOST_TESTS_PER_PROCESS * schedule->jobs);
+    }
+    free(schedule->steps);
+    free(schedule->tests);
+    free(schedule->workers);
+    free(schedule);
+}
+
+static int add_suite_steps(TestSchedule *schedule, TestSuite *suite, int parent) {
+    int i;
+    int start = add_step(schedule, suite_start, suite, NULL, parent);
+    if (start < 0) {
+        return -1;
+    }
+    for (i = 0; i < suite->size; i++) {
+        if (suite->tests[i].type == test_function) {
+            if (add_step(schedule, test_run, suite, &(suite->tests[i]), start) < 0) {
+                return -1;
+            }
+            schedule->steps[start].count++;
+        } else {
+            int nested = add_suite_steps(schedule, suite->tests[i].sPtr.suite, start);
+            if (nested < 0) {
+                return -1;
+            }
+            schedule->steps[start].count += schedule->steps[nested].count;
+        }
+    }
+    return add_step(schedule, suite_finish, suite, NULL, parent) < 0 ? -1 : start;
+}
+
+static int add_step(TestSchedule *schedule, int type, TestSuite *suite, UnitTest *test, int parent) {
+    RunStep *steps = (RunStep *)realloc(schedule->steps, sizeof(RunStep) * (schedule->step_count + 1));
+    RunStep *step;
+    if (steps == NULL) {
+        return -1;
+    }
+    schedule->steps = steps;
+    step = &schedule->steps[schedule->step_count];
+    memset(step, 0, sizeof(RunStep));
+    step->type = type;
+    step->suite = suite;
+    step->test = test;
+    step->parent = parent;
+    if (type == test_run) {
+        int *tests = (int *)realloc(schedule->tests, sizeof(int) * (schedule->test_count + 1));
+        if (tests == NULL) {
+            return -1;
+        }
+        schedule->tests = tests;
+        schedule->tests[schedule->test_count++] = schedule->step_count;
+    }
+    return schedule->step_count++;
+}
+
+static int create_workers(TestSchedule *schedule, int jobs) {
+    int i;
+    void *finished;
+    schedule->workers = (Worker *)calloc(jobs, sizeof(Worker));
+    if (schedule->workers == NULL) {
+        return 0;
+    }
+    schedule->jobs = jobs;
+    finished = mmap(NULL, sizeof(FinishedTest) * MOST_TESTS_PER_PROCESS * jobs,
+                    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (finished == MAP_FAILED) {
+        return 0;
+    }
+    schedule->finished = (FinishedTest *)finished;
+    for (i = 0; i < jobs; i++) {
+        Worker *worker = &schedule->workers[i];
+        worker->finished = schedule->finished + MOST_TESTS_PER_PROCESS * i;
+        worker->ipc = start_cgreen_messaging(100 + i);
+        worker->output = tmpfile();
+        if (worker->ipc == -1 || worker->output == NULL) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Tests are only run side by side while they share the set ups of the
+   suites around them. Those run in the process that forks the tests, once
+   around each nested suite as it is reported, as in run_every_test(). */
+static void run_schedule(TestSchedule *schedule, TestReporter *reporter) {
+    int i, begin, end;
+    report_finished_steps(schedule, reporter);
+    for (begin = 0; begin < schedule->test_count; begin = end) {
+        end = end_of_fixture(schedule, begin);
+        deal_tests(schedule, begin, end);
+        for (;;) {
+            for (i = 0; i < schedule->jobs; i++) {
+                if (! schedule->workers[i].busy) {
+                    launch_tests(schedule, i, reporter);
+                }
+            }
+            if (schedule->running == 0) {
+                break;
+            }
+            wait_for_any_worker(schedule);
+            report_finished_steps(schedule, reporter);
+        }
+    }
+    if (schedule->trace) {
+        show_schedule_trace(schedule);
+    }
+}
+
+static int end_of_fixture(TestSchedule *schedule, int begin) {
+    int fixture = enclosing_fixture(schedule, schedule->tests[begin]);
+    int end = begin + 1;
+    while (end < schedule->test_count && enclosing_fixture(schedule, schedule->tests[end]) == fixture) {
+        end++;
+    }
+    return end;
+}
+
+static void deal_tests(TestSchedule *schedule, int begin, int end) {
+    int i;
+    for (i = 0; i < schedule->jobs; i++) {
+        Worker *worker = &schedule->workers[i];
+        worker->head = begin + (int)((long)(end - begin) * i / schedule->jobs);
+        worker->tail = begin + (int)((long)(end - begin) * (i + 1) / schedule->jobs);
+    }
+}
+
+/* The innermost nested suite around a step whose parent has a set up or
+   tear down of its own, as its start step, or -1 when there is none */
+static int enclosing_fixture(TestSchedule *schedule, int step) {
+    int entry = schedule->steps[step].parent;
+    while (entry >= 0) {
+        int parent = schedule->steps[entry].parent;
+        if (parent >= 0 && has_fixture(schedule->steps[parent].suite)) {
+            return entry;
+        }
+        entry = parent;
+    }
+    return -1;
+}
+
+static int is_fixture_boundary(TestSchedule *schedule, RunStep *step) {
+    return step->type != test_run && step->parent >= 0 && has_fixture(schedule->steps[step->parent].suite);
+}
+
+/* The fork server holds the state the tests are forked with, so it runs
+   the set up or tear down, and the runner waits to carry on reporting */
+static void run_fixture(TestSchedule *schedule, int parent, int type) {
+    TestRequest request;
+    TestCompletion done;
+    ssize_t received;
+    flush_standard_reporter_output();
+    if (schedule->fork_server <= 0) {
+        call_fixture(schedule->steps[parent].suite, type);
+        return;
+    }
+    request.worker = -1;
+    request.first = parent;
+    request.last = type;
+    if (write(schedule->requests, &request, sizeof(request)) != sizeof(request)) {
+        die("Lost contact with the fork server\n");
+    }
+    do {
+        received = read(schedule->completions, &done, sizeof(done));
+    } while (received < 0 && errno == EINTR);
+    if (received != sizeof(done) || done.worker != -1) {
+        die("Lost contact with the fork server\n");
+    }
+}
+
+static void call_fixture(TestSuite *suite, int type) {
+    if (type == suite_start) {
+        (*suite->setup)();
+    } else {
+        (*suite->teardown)();
+    }
+}
+
+static int has_fixture(TestSuite *suite) {
+    return suite->setup != &do_nothing || suite->teardown != &do_nothing;
+}
+
+static int take_tests_for(TestSchedule *schedule, int worker) {
+    Worker *own = &schedule->workers[worker];
+    int count = 1;
+    if (own->head == own->tail) {
+        Worker *busiest;
+        int victim = busiest_worker(schedule);
+        if (victim < 0) {
+            return 0;
+        }
+        busiest = &schedule->workers[victim];
+        own->tail = busiest->tail;
+        busiest->tail -= (busiest->tail - busiest->head + 1) / 2;
+        own->head = busiest->tail;
+        own->steals += own->tail - own->head;
+        if (schedule->trace) {
+            fprintf(stderr, "cgreen: worker %d steals %d from worker %d\n", worker, own->tail - own->head, victim);
+        }
+    }
+    if (schedule->seconds_per_test > 0.0) {
+        double fits = SECONDS_PER_PROCESS / schedule->seconds_per_test;
+        count = fits < schedule->batch ? (int)fits : schedule->batch;
+    }
+    if (count < 1) {
+        count = 1;
+    }
+    if (count > own->tail - own->head) {
+        count = own->tail - own->head;
+    }
+    own->first = own->head;
+    own->last = own->head + count;
+    own->head = own->last;
+    return count;
+}
+
+static int busiest_worker(TestSchedule *schedule) {
+    int i, busiest = -1, most = 0;
+    for (i = 0; i < schedule->jobs; i++) {
+        int waiting = schedule->workers[i].tail - schedule->workers[i].head;
+        if (waiting > most) {
+            most = waiting;
+            busiest = i;
+        }
+    }
+    return busiest;
+}
+
+static void launch_tests(TestSchedule *schedule, int index, TestReporter *reporter) {
+    Worker *worker = &schedule->workers[index];
+    int count = take_tests_for(schedule, index);
+    if (count == 0) {
+        return;
+    }
+    worker->processes++;
+    if (schedule->trace) {
+        const char *name = schedule->steps[schedule->tests[worker->first]].test->name;
+        if (count == 1) {
+            fprintf(stderr, "cgreen: worker %d runs \"%s\"\n", index, name);
+        } else {
+            fprintf(stderr, "cgreen: worker %d runs %d tests from \"%s\"\n", index, count, name);
+        }
+    }
+    rewind(worker->output);
+    if (ftruncate(fileno(worker->output), 0) < 0) {
+        die("Could not reset the output of worker %d\n", index);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &worker->started);
+    worker->busy = 1;
+    schedule->running++;
+    if (schedule->fork_server > 0) {
+        TestRequest request;
+        request.worker = index;
+        request.first = worker->first;
+        request.last = worker->last;
+        if (write(schedule->requests, &request, sizeof(request)) != sizeof(request)) {
+            die("Lost contact with the fork server\n");
+        }
+        return;
+    }
+    /* The worker writes to its own capture file and drops the queued
+       report text, so there is no need to wait for that to be written */
+    fflush(NULL);
+    worker->pid = fork();
+    if (worker->pid < 0) {
+        die("Could not fork process\n");
+    }
+    if (worker->pid == 0) {
+        run_tests_in_worker(schedule, worker, reporter);
+    }
+}
+
+/* The tests' output is line buffered, set once before any test writes */
+static void run_tests_in_worker(TestSchedule *schedule, Worker *worker, TestReporter *reporter) {
+    static char line_buffer[BUFSIZ];
+    int i;
+    reporter->ipc = worker->ipc;
+    setvbuf(stdout, line_buffer, _IOLBF, sizeof(line_buffer));
+    for (i = worker->first; i < worker->last; i++) {
+        FinishedTest *finished = &worker->finished[i - worker->first];
+        struct timespec started;
+        struct rusage before, after;
+        clock_gettime(CLOCK_MONOTONIC, &started);
+        getrusage(RUSAGE_SELF, &before);
+        run_test_in_worker(schedule, worker, i, reporter);
+        flush_standard_reporter_output();
+        fflush(stdout);
+        getrusage(RUSAGE_SELF, &after);
+        measure_test(&finished->metrics, &started, &before, &after);
+        finished->end = (long)lseek(STDOUT_FILENO, 0, SEEK_CUR);
+    }
+    stop();
+}
+
+static void run_test_in_worker(TestSchedule *schedule, Worker *worker, int test, TestReporter *reporter) {
+    RunStep *step = &schedule->steps[schedule->tests[test]];
+    int quiet = open("/dev/null", O_WRONLY);
+    if (quiet >= 0) {
+        dup2(quiet, STDOUT_FILENO);
+        close(quiet);
+    }
+    while (get_breadcrumb_depth((CgreenBreadcrumb *)reporter->breadcrumb) > 0) {
+        pop_breadcrumb((CgreenBreadcrumb *)reporter->breadcrumb);
+    }
+    start_enclosing_suites(schedule, step->parent, reporter);
+    (*reporter->start_test)(reporter, step->test->name);
+    flush_standard_reporter_output();
+    fflush(stdout);
+    dup2(fileno(worker->output), STDOUT_FILENO);
+    run_the_test_code(step->suite, step->test, reporter);
+    send_reporter_completion_notification(reporter);
+}
+
+static void start_enclosing_suites(TestSchedule *schedule, int start, TestReporter *reporter) {
+    if (start >= 0) {
+        start_enclosing_suites(schedule, schedule->steps[start].parent, reporter);
+        (*reporter->start_suite)(reporter, schedule->steps[start].suite->name, schedule->steps[start].count);
+    }
+}
+
+static void wait_for_any_worker(TestSchedule *schedule) {
+    ignore_ctrl_c();
+    if (schedule->fork_server > 0) {
+        wait_for_fork_server(schedule);
+    } else {
+        wait_for_any_test_process(schedule);
+    }
+    allow_ctrl_c();
+}
+
+static void wait_for_any_test_process(TestSchedule *schedule) {
+    int i, status;
+    struct rusage usage;
+    pid_t child;
+    do {
+        child = wait4(-1, &status, 0, &usage);
+    } while (child < 0 && errno == EINTR);
+    if (child < 0) {
+        die("Lost track of running tests\n");
+    }
+    for (i = 0; i < schedule->jobs; i++) {
+        if (schedule->workers[i].busy && schedule->workers[i].pid == child) {
+            collect_results(schedule, &schedule->workers[i], &usage);
+            schedule->workers[i].busy = 0;
+            schedule->running--;
+            return;
+        }
+    }
+}
+
+static void wait_for_fork_server(TestSchedule *schedule) {
+    TestCompletion completion;
+    ssize_t received;
+    do {
+        received = read(schedule->completions, &completion, sizeof(completion));
+    } while (received < 0 && errno == EINTR);
+    if (received != sizeof(completion) || completion.worker < 0 || completion.worker >= schedule->jobs) {
+        die("Lost contact with the fork server\n");
+    }
+    collect_results(schedule, &schedule->workers[completion.worker], &completion.usage);
+    schedule->workers[completion.worker].busy = 0;
+    schedule->running--;
+}
+
+static int start_fork_server(TestSchedule *schedule, TestReporter *reporter) {
+    int requests[2], completions[2];
+    if (pipe(requests) < 0) {
+        return 0;
+    }
+    if (pipe(completions) < 0) {
+        close(requests[0]);
+        close(requests[1]);
+        return 0;
+    }
+    flush_standard_reporter_output();
+    fflush(NULL);
+    schedule->fork_server = fork();
+    if (schedule->fork_server < 0) {
+        close(requests[0]);
+        close(requests[1]);
+        close(completions[0]);
+        close(completions[1]);
+        return 0;
+    }
+    if (schedule->fork_server == 0) {
+        close(requests[1]);
+        close(completions[0]);
+        serve_test_processes(schedule, reporter, requests[0], completions[1]);
+    }
+    close(requests[0]);
+    close(completions[1]);
+    schedule->requests = requests[1];
+    schedule->completions = completions[0];
+    return 1;
+}
+
+static void stop_fork_server(TestSchedule *schedule) {
+    int status;
+    if (schedule->fork_server <= 0) {
+        return;
+    }
+    close(schedule->requests);
+    close(schedule->completions);
+    while (waitpid(schedule->fork_server, &status, 0) < 0 && errno == EINTR) {
+    }
+    schedule->fork_server = 0;
+}
+
+static void serve_test_processes(TestSchedule *schedule, TestReporter *reporter, int requests, int completions) {
+    struct pollfd events[2];
+    int wake_up[2];
+    if (pipe(wake_up) < 0) {
+        _exit(EXIT_FAILURE);
+    }
+    fcntl(wake_up[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_up[1], F_SETFL, O_NONBLOCK);
+    fork_server_wake_up = wake_up[1];
+    signal(SIGINT, SIG_IGN);
+    signal(SIGCHLD, &wake_fork_server);
+    events[0].fd = requests;
+    events[0].events = POLLIN;
+    events[1].fd = wake_up[0];
+    events[1].events = POLLIN;
+    for (;;) {
+        if (poll(events, 2, -1) < 0) {
+            continue;
+        }
+        if (events[1].revents & POLLIN) {
+            char ignored[64];
+            while (read(wake_up[0], ignored, sizeof(ignored)) > 0) {
+            }
+            report_completed_test_processes(schedule, completions);
+        }
+        if (events[0].revents & (POLLIN | POLLHUP)) {
+            TestRequest request;
+            if (read(requests, &request, sizeof(request)) != sizeof(request)) {
+                break;
+            }
+            if (request.worker < 0) {
+                run_fixture_for_request(schedule, &request, completions);
+            } else {
+                fork_test_for_request(schedule, reporter, &request);
+            }
+        }
+    }
+    _exit(EXIT_SUCCESS);
+}
+
+static void fork_test_for_request(TestSchedule *schedule, TestReporter *reporter, TestRequest *request) {
+    Worker *worker = &schedule->workers[request->worker];
+    worker->first = request->first;
+    worker->last = request->last;
+    worker->pid = fork();
+    if (worker->pid < 0) {
+        _exit(EXIT_FAILURE);
+    }
+    if (worker->pid == 0) {
+        signal(SIGCHLD, SIG_DFL);
+        signal(SIGINT, SIG_DFL);
+        run_tests_in_worker(schedule, worker, reporter);
+    }
+    worker->busy = 1;
+}
+
+static void run_fixture_for_request(TestSchedule *schedule, TestRequest *request, int completions) {
+    TestCompletion done;
+    call_fixture(schedule->steps[request->first].suite, request->last);
+    fflush(NULL);
+    memset(&done, 0, sizeof(done));
+    done.worker = -1;
+    if (write(completions, &done, sizeof(done)) != sizeof(done)) {
+        _exit(EXIT_FAILURE);
+    }
+}
+
+static void report_completed_test_processes(TestSchedule *schedule, int completions) {
+    int i, status;
+    struct rusage usage;
+    pid_t child;
+    while ((child = wait4(-1, &status, WNOHANG, &usage)) > 0) {
+        for (i = 0; i < schedule->jobs; i++) {
+            if (schedule->workers[i].busy && schedule->workers[i].pid == child) {
+                TestCompletion completion;
+                completion.worker = i;
+                completion.status = status;
+                completion.usage = usage;
+                schedule->workers[i].busy = 0;
+                if (write(completions, &completion, sizeof(completion)) != sizeof(completion)) {
+                    _exit(EXIT_FAILURE);
+                }
+            }
+        }
+    }
+}
+
+static void wake_fork_server(int signal_number) {
+    int saved = errno;
+    (void)signal_number;
+    if (write(fork_server_wake_up, "", 1) < 0) {
+        /* The pipe is full, so the server is already awake */
+    }
+    errno = saved;
+}
+
+static int fork_server_from_environment() {
+    const char *fork_server = getenv("CGREEN_FORK_SERVER");
+    return fork_server != NULL && strcmp(fork_server, "0") != 0;
+}
+
+static int batch_size_from_environment() {
+    const char *batch = getenv("CGREEN_BATCH");
+    int size;
+    if (batch == NULL || strcmp(batch, "0") == 0) {
+        return 1;
+    }
+    size = atoi(batch);
+    if (size <= 0) {
+        size = MOST_TESTS_PER_PROCESS / 4;
+    }
+    return size < MOST_TESTS_PER_PROCESS ? size : MOST_TESTS_PER_PROCESS;
+}
+
+/* The messages of each test in a batch end with its completion
+   notification. A test without one crashed its process, and the tests
+   after it go back to the front of the worker to be run again. */
+static void collect_results(TestSchedule *schedule, Worker *worker, const struct rusage *usage) {
+    size_t size;
+    char *output = read_captured_output(worker->output, &size);
+    size_t start = 0;
+    int test = worker->first;
+    HeldResult *held;
+    while (test < worker->last) {
+        RunStep *step = &schedule->steps[schedule->tests[test]];
+        size_t end = size;
+        int completed = 0;
+        step->results = create_cgreen_vector(&destroy_held_result);
+        while (! completed && (held = receive_held_result(worker->ipc)) != NULL) {
+            cgreen_vector_add(step->results, held);
+            completed = is_reporter_completion_notification(held->result);
+        }
+        if (completed) {
+            FinishedTest *finished = &worker->finished[test - worker->first];
+            if (finished->end >= (long)start && finished->end <= (long)size) {
+                end = (size_t)finished->end;
+            }
+            step->metrics = finished->metrics;
+        } else {
+            measure_crashed_test(step, worker, usage, test - worker->first);
+        }
+        step->output = copy_output(output, start, end, &step->output_size);
+        step->done = 1;
+        start = end;
+        test++;
+        if (! completed) {
+            break;
+        }
+    }
+    free(output);
+    time_batch(schedule, worker, test - worker->first);
+    worker->runs += test - worker->first;
+    worker->head = test;
+}
+
+/* A test that took its process down is charged with whatever the
+   process used beyond the tests that finished before it. */
+static void measure_crashed_test(RunStep *step, Worker *worker, const struct rusage *usage, int completed) {
+    TestMetrics *metrics = &step->metrics;
+    int i;
+    measure_test(metrics, &worker->started, NULL, usage);
+    for (i = 0; i < completed; i++) {
+        const TestMetrics *earlier = &worker->finished[i].metrics;
+        metrics->wall_time -= earlier->wall_time;
+        metrics->user_time -= earlier->user_time;
+        metrics->system_time -= earlier->system_time;
+        metrics->minor_faults -= earlier->minor_faults;
+        metrics->major_faults -= earlier->major_faults;
+        metrics->voluntary_switches -= earlier->voluntary_switches;
+        metrics->involuntary_switches -= earlier->involuntary_switches;
+    }
+}
+
+static HeldResult *receive_held_result(int messaging) {
+    HeldResult *held = (HeldResult *)malloc(sizeof(HeldResult));
+    if (held == NULL) {
+        die("Could not keep the results of a test\n");
+    }
+    held->result = receive_cgreen_message_with_payload(messaging, &held->payload, &held->size);
+    if (held->result <= 0) {
+        destroy_held_result(held);
+        return NULL;
+    }
+    return held;
+}
+
+static void destroy_held_result(void *held) {
+    free(((HeldResult *)held)->payload);
+    free(held);
+}
+
+static void time_batch(TestSchedule *schedule, Worker *worker, int tests) {
+    struct timespec finished;
+    double seconds;
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    seconds = seconds_between(&worker->started, &finished) / tests;
+    if (schedule->seconds_per_test == 0.0) {
+        schedule->seconds_per_test = seconds;
+    } else {
+        schedule->seconds_per_test += (seconds - schedule->seconds_per_test) / 4;
+    }
+}
+
+static char *read_captured_output(FILE *output, size_t *size) {
+    char *content = NULL;
+    size_t space = 0;
+    size_t length;
+    *size = 0;
+    rewind(output);
+    do {
+        if (*size == space) {
+            char *larger = (char *)realloc(content, space + BUFSIZ);
+            if (larger == NULL) {
+                break;
+            }
+            content = larger;
+            space += BUFSIZ;
+        }
+        length = fread(content + *size, 1, space - *size, output);
+        *size += length;
+    } while (length > 0);
+    return content;
+}
+
+static char *copy_output(const char *output, size_t start, size_t end, size_t *size) {
+    char *copy;
+    *size = 0;
+    if (output == NULL || end <= start) {
+        return NULL;
+    }
+    copy = (char *)malloc(end - start);
+    if (copy != NULL) {
+        memcpy(copy, output + start, end - start);
+        *size = end - start;
+    }
+    return copy;
+}
+
+static void report_finished_steps(TestSchedule *schedule, TestReporter *reporter) {
+    while (schedule->reported < schedule->step_count) {
+        RunStep *step = &schedule->steps[schedule->reported];
+        if (step->type == test_run && ! step->done) {
+            return;
+        }
+        if (step->type == suite_start && is_fixture_boundary(schedule, step)) {
+            run_fixture(schedule, step->parent, suite_start);
+        }
+        report_step(step, reporter);
+        if (step->type == suite_finish && is_fixture_boundary(schedule, step)) {
+            run_fixture(schedule, step->parent, suite_finish);
+        }
+        schedule->reported++;
+    }
+}
+
+static void report_step(RunStep *step, TestReporter *reporter) {
+    if (step->type == suite_start) {
+        (*reporter->start_suite)(reporter, step->suite->name, step->count);
+    } else if (step->type == test_run) {
+        report_test_step(step, reporter);
+    } else {
+        send_reporter_completion_notification(reporter);
+        (*reporter->finish_suite)(reporter, step->suite->name);
+    }
+}
+
+static void report_test_step(RunStep *step, TestReporter *reporter) {
+    int i;
+    (*reporter->start_test)(reporter, step->test->name);
+    if (step->output_size > 0) {
+        flush_standard_reporter_output();
+        fflush(stdout);
+        fwrite(step->output, 1, step->output_size, stdout);
+        fflush(stdout);
+    }
+    for (i = 0; i < cgreen_vector_size(step->results); i++) {
+        HeldResult *held = (HeldResult *)cgreen_vector_get(step->results, i);
+        send_cgreen_message_with_payload(reporter->ipc, held->result, held->payload, held->size);
+    }
+    (*reporter->record_metrics)(reporter, step->test->name, &step->metrics);
+    (*reporter->finish_test)(reporter, step->test->name);
+    destroy_cgreen_vector(step->results);
+    step->results = NULL;
+    free(step->output);
+    step->output = NULL;
+}
+
+static void show_schedule_trace(TestSchedule *schedule) {
+    int i;
+    for (i = 0; i < schedule->jobs; i++) {
+        fprintf(stderr, "cgreen: worker %d ran %d test%s in %d process%s, %d stolen\n",
+                i,
+                schedule->workers[i].runs,
+                schedule->workers[i].runs == 1 ? "" : "s",
+                schedule->workers[i].processes,
+                schedule->workers[i].processes == 1 ? "" : "es",
+                schedule->workers[i].steals);
+    }
+}
+
 static int in_child_process() {
-    pid_t child = fork();
+    pid_t child;
+    flush_standard_reporter_output();
+    fflush(NULL);
+    child = fork();
     if (child < 0) {
         die("Could not fork process\n");
     }
     return ! child;
 }
-#endif
 
-#ifndef WIN32
-static void wait_for_child_process() {
+static void wait_for_child_process(struct rusage *usage) {
     int status;
     ignore_ctrl_c();
-    wait(&status);
+    while (wait4(-1, &status, 0, usage) < 0 && errno == EINTR) {
+    }
     allow_ctrl_c();
 }
 
+static void measure_test(TestMetrics *metrics, const struct timespec *started, const struct rusage *before, const struct rusage *after) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    metrics->wall_time = seconds_between(started, &now);
+    metrics->user_time = seconds_of(&after->ru_utime);
+    metrics->system_time = seconds_of(&after->ru_stime);
+    metrics->minor_faults = after->ru_minflt;
+    metrics->major_faults = after->ru_majflt;
+    metrics->voluntary_switches = after->ru_nvcsw;
+    metrics->involuntary_switches = after->ru_nivcsw;
+    if (before != NULL) {
+        metrics->user_time -= seconds_of(&before->ru_utime);
+        metrics->system_time -= seconds_of(&before->ru_stime);
+        metrics->minor_faults -= before->ru_minflt;
+        metrics->major_faults -= before->ru_majflt;
+        metrics->voluntary_switches -= before->ru_nvcsw;
+        metrics->involuntary_switches -= before->ru_nivcsw;
+    }
+#ifdef __APPLE__
+    metrics->max_resident_kb = after->ru_maxrss / 1024;
+#else
+    metrics->max_resident_kb = after->ru_maxrss;
+#endif
+}
+
+static double seconds_between(const struct timespec *from, const struct timespec *to) {
+    return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+static double seconds_of(const struct timeval *time) {
+    return time->tv_sec + time->tv_usec / 1e6;
+}
+#endif
+
+#ifndef WIN32
+
 static void ignore_ctrl_c() {
     signal(SIGINT, SIG_IGN);
 }
@@ -380,7 +1738,88 @@ static void stop() {
 }
 #endif
 
+static int in_process_from_environment() {
+    const char *in_process = getenv("CGREEN_IN_PROCESS");
+    return in_process != NULL && strcmp(in_process, "0") != 0;
+}
+
+#if !defined(WIN32) && !defined(IPHONE)
+/* A crash within the test code jumps back to the runner, on a stack of
+   its own in case the test overflowed the normal one. Without a test
+   running, the signal is raised again so the process dies as usual. */
+static CrashRecovery *start_crash_recovery() {
+    CrashRecovery *previous = (CrashRecovery *)calloc(1, sizeof(CrashRecovery));
+    struct sigaction action;
+    stack_t stack;
+    int i;
+    if (previous == NULL) {
+        return NULL;
+    }
+    previous->stack_memory = malloc(SIGNAL_STACK_SIZE);
+    if (previous->stack_memory == NULL) {
+        free(previous);
+        return NULL;
+    }
+    stack.ss_sp = previous->stack_memory;
+    stack.ss_size = SIGNAL_STACK_SIZE;
+    stack.ss_flags = 0;
+    if (sigaltstack(&stack, &previous->stack) < 0) {
+        free(previous->stack_memory);
+        free(previous);
+        return NULL;
+    }
+    memcpy(previous->recovery, crash_recovery, sizeof(sigjmp_buf));
+    previous->armed = crash_recovery_armed;
+    crash_recovery_armed = 0;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = &recover_from_crash;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_ONSTACK;
+    for (i = 0; i < CRASH_SIGNAL_COUNT; i++) {
+        sigaction(crash_signals[i], &action, &previous->actions[i]);
+    }
+    return previous;
+}
+
+static void stop_crash_recovery(CrashRecovery *previous) {
+    int i;
+    for (i = 0; i < CRASH_SIGNAL_COUNT; i++) {
+        sigaction(crash_signals[i], &previous->actions[i], NULL);
+    }
+    sigaltstack(&previous->stack, NULL);
+    memcpy(crash_recovery, previous->recovery, sizeof(sigjmp_buf));
+    crash_recovery_armed = previous->armed;
+    free(previous->stack_memory);
+    free(previous);
+}
+
+static void recover_from_crash(int signal_number) {
+    if (crash_recovery_armed) {
+        crash_recovery_armed = 0;
+        siglongjmp(crash_recovery, signal_number);
+    }
+    signal(signal_number, SIG_DFL);
+    raise(signal_number);
+}
+
+static void time_out(int signal_number) {
+    if (crash_recovery_armed) {
+        recover_from_crash(signal_number);
+    }
+    stop();
+}
+#endif
+
+static int jobs_from_environment() {
+    const char *jobs = getenv("CGREEN_JOBS");
+    if (jobs == NULL) {
+        return 1;
+    }
+    return atoi(jobs);
+}
+
 static void run_the_test_code(TestSuite *suite, UnitTest *test, TestReporter *reporter) {
+    set_test_reporter(reporter);
     significant_figures_for_assert_double_are(8);
     clear_mocks();
     (*suite->setup)();
@@ -404,6 +1843,7 @@ static void tally_counter(const char *file, int line, int expected, int actual,
 static void die(const char *message, ...) {
 	va_list arguments;
 	va_start(arguments, message);
+	flush_standard_reporter_output();
 	vprintf(message, arguments);
 	va_end(arguments);
 	exit(EXIT_FAILURE);
@@ -1,13 +1,19 @@
 #include <cgreen/vector.h>
 #include <stdlib.h>
 
+/* Items are held in a ring, so taking them from the front costs no
+   more than taking them from the back. The space is always a power of
+   two, doubled when full, so positions wrap with a mask. */
 struct CgreenVector_ {
     int size;
     void (*destructor)(void *);
     int space;
+    int first;
     void **items;
 };
 
+#define SLOT(vector, position) (((vector)->first + (position)) & ((vector)->space - 1))
+
 static void increase_space(CgreenVector *vector);
 
 CgreenVector *create_cgreen_vector(void (*destructor)(void *)) {
@@ -15,6 +21,7 @@ CgreenVector *create_cgreen_vector(void (*destructor)(void *)) {
     vector->size = 0;
     vector->destructor = destructor;
     vector->space = 0;
+    vector->first = 0;
     vector->items = NULL;
     return vector;
 }
@@ -23,7 +30,7 @@ void destroy_cgreen_vector(CgreenVector *vector) {
     int i;
     if (vector->destructor != NULL) {
         for (i = 0; i < vector->size; i++) {
-            (*vector->destructor)(vector->items[i]);
+            (*vector->destructor)(vector->items[SLOT(vector, i)]);
         }
     }
     free(vector->items);
@@ -34,31 +41,55 @@ void cgreen_vector_add(CgreenVector *vector, void *item) {
     if (vector->size == vector->space) {
         increase_space(vector);
     }
-    vector->items[vector->size] = item;
+    vector->items[SLOT(vector, vector->size)] = item;
     vector->size++;
 }
 
+/* Closes the gap from whichever end is nearer */
 void *cgreen_vector_remove(CgreenVector *vector, int position) {
-    void *item = vector->items[position];
+    void *item;
     int i;
-    for (i = position; i < vector->size; i++) {
-        vector->items[i] = vector->items[i + 1];
+    if (position < 0 || position >= vector->size) {
+        return NULL;
+    }
+    item = vector->items[SLOT(vector, position)];
+    if (position < vector->size / 2) {
+        for (i = position; i > 0; i--) {
+            vector->items[SLOT(vector, i)] = vector->items[SLOT(vector, i - 1)];
+        }
+        vector->first = SLOT(vector, 1);
+    } else {
+        for (i = position; i < vector->size - 1; i++) {
+            vector->items[SLOT(vector, i)] = vector->items[SLOT(vector, i + 1)];
+        }
     }
     vector->size--;
     return item;
 }
 
 void *cgreen_vector_get(CgreenVector *vector, int position) {
-    return vector->items[position];
+    if (position < 0 || position >= vector->size) {
+        return NULL;
+    }
+    return vector->items[SLOT(vector, position)];
 }
 
 int cgreen_vector_size(CgreenVector *vector) {
     return (vector == NULL ? 0 : vector->size);
 }
 
+/* Unwraps the ring into the new space, so the items start at the front */
 static void increase_space(CgreenVector *vector) {
-    vector->space += 100;
-    vector->items = (void**)realloc(vector->items, sizeof(void *) * vector->space);
+    int space = vector->space == 0 ? 16 : vector->space * 2;
+    void **items = (void **)malloc(sizeof(void *) * space);
+    int i;
+    for (i = 0; i < vector->size; i++) {
+        items[i] = vector->items[SLOT(vector, i)];
+    }
+    free(vector->items);
+    vector->items = items;
+    vector->space = space;
+    vector->first = 0;
 }
 
 /* vim: set ts=4 sw=4 et cindent: */
@@ -3,12 +3,18 @@
 TestSuite *messaging_tests();
 TestSuite *assertion_tests();
 TestSuite *vector_tests();
+TestSuite *memory_tests();
 TestSuite *constraint_tests();
 TestSuite *parameter_tests();
 TestSuite *mock_tests();
 TestSuite *breadcrumb_tests();
 TestSuite *slurp_tests();
+TestSuite *cdash_reporter_tests();
 TestSuite *cute_reporter_tests();
+TestSuite *junit_reporter_tests();
+TestSuite *event_log_reporter_tests();
+TestSuite *multiplexing_reporter_tests();
+TestSuite *reporter_output_tests();
 TestSuite *unit_tests();
 TestSuite *collector_tests();
 
@@ -17,16 +23,22 @@ int main(int argc, char **argv) {
     add_suite(suite, messaging_tests());
     add_suite(suite, assertion_tests());
     add_suite(suite, vector_tests());
+    add_suite(suite, memory_tests());
     add_suite(suite, constraint_tests());
     add_suite(suite, parameter_tests());
     add_suite(suite, mock_tests());
     add_suite(suite, breadcrumb_tests());
     add_suite(suite, slurp_tests());
+    add_suite(suite, cdash_reporter_tests());
     add_suite(suite, cute_reporter_tests());
+    add_suite(suite, junit_reporter_tests());
+    add_suite(suite, event_log_reporter_tests());
+    add_suite(suite, multiplexing_reporter_tests());
+    add_suite(suite, reporter_output_tests());
     add_suite(suite, collector_tests());
     add_suite(suite, unit_tests());
     if (argc > 1) {
-        return run_single_test(suite, argv[1], create_text_reporter());
+        return run_selected_tests(suite, argv + 1, argc - 1, create_text_reporter());
     }
     return run_test_suite(suite, create_text_reporter());
 }
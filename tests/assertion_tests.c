@@ -1,6 +1,8 @@
 #include <cgreen/cgreen.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
 
 Ensure integer_one_should_assert_true() {
     assert_true(1);
@@ -160,6 +162,25 @@ Ensure double_differences_matter_past_significant_figures() {
 	assert_double_not_equal(1113000, 1115000);
 }
 
+Ensure double_significant_figures_count_for_negatives_and_small_values() {
+	significant_figures_for_assert_double_are(3);
+	assert_double_equal(-1113, -1115);
+	assert_double_not_equal(-1113, 1113);
+	assert_double_equal(0.0001113, 0.0001115);
+	assert_double_not_equal(0.0001113, 0.0001125);
+	assert_double_not_equal(0, 0.0001);
+	assert_double_equal(0.0, -0.0);
+}
+
+Ensure double_differences_can_be_counted_in_units_in_the_last_place() {
+	units_in_last_place_for_assert_double_are(1);
+	assert_double_equal(1.0, 1.0 + 2.220446049250313e-16);
+	assert_double_not_equal(1.0, 1.0 + 4.440892098500626e-16);
+	assert_double_equal(4.9406564584124654e-324, -4.9406564584124654e-324 + 4.9406564584124654e-324);
+	significant_figures_for_assert_double_are(8);
+	assert_double_equal(1.0, 1.000000001);
+}
+
 Ensure double_assertions_can_have_custom_messages() {
 	significant_figures_for_assert_double_are(3);
 	assert_double_equal_with_message(1.113, 1.115, "This should pass");
@@ -187,6 +208,71 @@ Ensure null_string_should_only_match_another_null_string_even_with_messages() {
     assert_string_not_equal_with_message("", NULL, "Oh dear");
 }
 
+Ensure identical_memory_should_match() {
+    char tried[1000];
+    char expected[1000];
+    memset(tried, 'x', sizeof(tried));
+    memset(expected, 'x', sizeof(expected));
+    assert_memory_equal(tried, expected, sizeof(tried));
+    assert_memory_equal(tried, "y", 0);
+}
+
+Ensure identical_arrays_should_match() {
+    int tried[] = {1, 2, 3, 4, 5};
+    int expected[] = {1, 2, 3, 4, 5};
+    double nearly[] = {1.0, 2.0, 3.0000000001, 4.0};
+    double exactly[] = {1.0, 2.0, 3.0, 4.0};
+    assert_int_array_equal(tried, expected, 5);
+    assert_double_array_equal(nearly, exactly, 4);
+}
+
+static int captured_result;
+static char captured_message[512];
+
+static void capture_assertion(TestReporter *reporter, const char *file, int line, int result, const char *message, ...) {
+    va_list arguments;
+    va_start(arguments, message);
+    captured_result = result;
+    vsnprintf(captured_message, sizeof(captured_message), message, arguments);
+    va_end(arguments);
+}
+
+#define capturing(assertion) \
+    do { \
+        void (*assert_true)(TestReporter *, const char *, int, int, const char *, ...) = get_test_reporter()->assert_true; \
+        get_test_reporter()->assert_true = &capture_assertion; \
+        assertion; \
+        get_test_reporter()->assert_true = assert_true; \
+    } while (0)
+
+Ensure first_memory_difference_is_shown_with_its_neighbours() {
+    unsigned char tried[4096];
+    unsigned char expected[4096];
+    memset(tried, 0xaa, sizeof(tried));
+    memset(expected, 0xaa, sizeof(expected));
+    tried[3000] = 0x01;
+    tried[3001] = 0x02;
+    capturing(assert_memory_equal(tried, expected, sizeof(tried)));
+    assert_false(captured_result);
+    assert_string_equal(captured_message,
+            "Memory differs at byte [3000] of [4096]: "
+            "[... aa aa aa aa aa aa aa aa <01> 02 aa aa aa aa aa aa aa ...] should match "
+            "[... aa aa aa aa aa aa aa aa <aa> aa aa aa aa aa aa aa aa ...]");
+}
+
+Ensure first_array_difference_is_shown_with_its_neighbours() {
+    int tried[] = {1, 2, 3, 4, 5};
+    int expected[] = {1, 2, 3, 7, 5};
+    double tried_doubles[] = {0.5, 1.5, 2.5};
+    double expected_doubles[] = {0.5, 1.5000000001, 2.75};
+    capturing(assert_int_array_equal(tried, expected, 5));
+    assert_false(captured_result);
+    assert_string_equal(captured_message, "Arrays differ at index [3] of [5]: [1 2 3 <4> 5] should match [1 2 3 <7> 5]");
+    capturing(assert_double_array_equal(tried_doubles, expected_doubles, 3));
+    assert_false(captured_result);
+    assert_string_equal(captured_message, "Arrays differ at index [2] of [3]: [0.5 1.5 <2.5>] should match [0.5 1.5 <2.75>]");
+}
+
 TestSuite *assertion_tests() {
     TestSuite *suite = create_test_suite();
     add_test(suite, integer_one_should_assert_true);
@@ -217,7 +303,13 @@ TestSuite *assertion_tests() {
     add_test(suite, zero_should_assert_long_double_not_equal_to_one);
     add_test(suite, double_differences_do_not_matter_past_significant_figures);
     add_test(suite, double_differences_matter_past_significant_figures);
+    add_test(suite, double_significant_figures_count_for_negatives_and_small_values);
+    add_test(suite, double_differences_can_be_counted_in_units_in_the_last_place);
     add_test(suite, double_assertions_can_have_custom_messages);
+    add_test(suite, identical_memory_should_match);
+    add_test(suite, identical_arrays_should_match);
+    add_test(suite, first_memory_difference_is_shown_with_its_neighbours);
+    add_test(suite, first_array_difference_is_shown_with_its_neighbours);
     add_test(suite, identical_string_copies_should_match);
     add_test(suite, case_different_strings_should_not_match);
     add_test(suite, null_string_should_only_match_another_null_string);
@@ -0,0 +1,113 @@
+#include <cgreen/cgreen.h>
+#include <cgreen/cdash_reporter.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "reporter_fixture.h"
+
+static CDashInfo cdash = {"site", "build", "Experimental", "host", "os", "platform", "release", "version"};
+static TestReporter *reporter;
+
+static void create_cdash_reporter_beside_the_running_one() {
+    keep_running_reporter();
+    reporter = beside_running_reporter(create_cdash_reporter(&cdash), 669);
+}
+
+static void destroy_cdash_reporter() {
+    destroy_reporter_beside_running_one(&reporter);
+}
+
+static char *finish_and_read() {
+    char path[100];
+    char stamp[20];
+    FILE *file;
+    long size;
+    char *text;
+    destroy_cdash_reporter();
+    file = fopen("./Testing/TAG", "r");
+    fscanf(file, "%19s", stamp);
+    fclose(file);
+    snprintf(path, sizeof(path), "./Testing/%s/Test.xml", stamp);
+    file = fopen(path, "r");
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    rewind(file);
+    text = (char *)malloc(size + 1);
+    text[fread(text, 1, size, file)] = '\0';
+    fclose(file);
+    return text;
+}
+
+static int count(const char *text, const char *part) {
+    int found = 0;
+    while ((text = strstr(text, part)) != NULL) {
+        found++;
+        text++;
+    }
+    return found;
+}
+
+static void run_test(const char *name, int passes, const char *failure) {
+    (*reporter->start_test)(reporter, name);
+    for (; passes > 0; passes--) {
+        (*reporter->assert_true)(reporter, "file.c", 6, 1, NULL);
+    }
+    if (failure != NULL) {
+        (*reporter->assert_true)(reporter, "file.c", 7, 0, "%s", failure);
+    }
+    send_reporter_completion_notification(reporter);
+    (*reporter->finish_test)(reporter, name);
+}
+
+Ensure each_test_is_reported_once_however_many_assertions_pass() {
+    char *text;
+    (*reporter->start_suite)(reporter, "suite", 2);
+    run_test("first", 3, NULL);
+    run_test("second", 5, NULL);
+    send_reporter_completion_notification(reporter);
+    (*reporter->finish_suite)(reporter, "suite");
+    text = finish_and_read();
+    assert_equal(count(text, "<Test Status=\"passed\">"), 2);
+    assert_true(strstr(text, "<FullName>suite/second</FullName>") != NULL);
+    free(text);
+}
+
+Ensure long_failure_message_is_reported_whole_and_escaped() {
+    char message[5000];
+    char *text;
+    memset(message, 'x', sizeof(message) - 1);
+    message[sizeof(message) - 1] = '\0';
+    memcpy(message, "<&>'\a", 5);
+    (*reporter->start_suite)(reporter, "suite", 1);
+    run_test("fails", 1, message);
+    send_reporter_completion_notification(reporter);
+    (*reporter->finish_suite)(reporter, "suite");
+    text = finish_and_read();
+    assert_equal(count(text, "<Test Status=\"failed\">"), 1);
+    assert_true(strstr(text, "file.c:7: &lt;&amp;&gt;&apos;?xxxx") != NULL);
+    assert_true(strstr(text, message + 5) != NULL);
+    free(text);
+}
+
+Ensure test_that_does_not_complete_fails() {
+    char *text;
+    (*reporter->start_suite)(reporter, "suite", 1);
+    (*reporter->start_test)(reporter, "crashes");
+    (*reporter->finish_test)(reporter, "crashes");
+    send_reporter_completion_notification(reporter);
+    (*reporter->finish_suite)(reporter, "suite");
+    text = finish_and_read();
+    assert_equal(count(text, "<Test Status=\"failed\">"), 1);
+    assert_true(strstr(text, "<Value>Failed to complete</Value>") != NULL);
+    free(text);
+}
+
+TestSuite *cdash_reporter_tests() {
+    TestSuite *suite = create_test_suite();
+    setup(suite, create_cdash_reporter_beside_the_running_one);
+    teardown(suite, destroy_cdash_reporter);
+    add_test(suite, each_test_is_reported_once_however_many_assertions_pass);
+    add_test(suite, long_failure_message_is_reported_whole_and_escaped);
+    add_test(suite, test_that_does_not_complete_fails);
+    return suite;
+}
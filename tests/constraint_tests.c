@@ -73,6 +73,13 @@ Ensure constraints_on_doubles_respect_significant_figure_setting() {
     destroy_constraint(want_337);
 }
 
+Ensure doubles_keep_their_value_when_passed_as_arguments() {
+    Constraint *want_tiny = want_double(label, -1.5e-300);
+    assert_equal(compare_constraint(want_tiny, box_double(-1.5e-300)), 1);
+    assert_equal(compare_constraint(want_tiny, box_double(1.5e-300)), 0);
+    destroy_constraint(want_tiny);
+}
+
 TestSuite *constraint_tests() {
     TestSuite *suite = create_test_suite();
     add_test(suite, can_construct_and_destroy_an_want_constraint);
@@ -86,5 +93,6 @@ TestSuite *constraint_tests() {
     add_test(suite, equal_doubles_compare_true_with_a_want_double_constraint);
     add_test(suite, unequal_doubles_compare_false_with_a_want_double_constraint);
     add_test(suite, constraints_on_doubles_respect_significant_figure_setting);
+    add_test(suite, doubles_keep_their_value_when_passed_as_arguments);
     return suite;
 }
@@ -0,0 +1,177 @@
+#include <cgreen/cgreen.h>
+#include <cgreen/event_log_reporter.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "reporter_fixture.h"
+
+#define EVENT_LOG_FILE "event_log_reporter_tests.log"
+
+static TestReporter *log_reporter;
+
+static char tests_started[100];
+static char failure[100];
+static int failure_line;
+static int incomplete_tests;
+static double measured_time;
+static int replayed_passes;
+static int replayed_failures;
+static int replayed_exceptions;
+
+static void create_log_reporter_beside_the_running_one() {
+    keep_running_reporter();
+    log_reporter = beside_running_reporter(create_event_log_reporter(EVENT_LOG_FILE), 668);
+    tests_started[0] = '\0';
+    failure[0] = '\0';
+    failure_line = 0;
+    incomplete_tests = 0;
+    measured_time = 0.0;
+    replayed_passes = replayed_failures = replayed_exceptions = -1;
+}
+
+static void close_log() {
+    destroy_reporter_beside_running_one(&log_reporter);
+}
+
+static void remove_event_log() {
+    close_log();
+    remove(EVENT_LOG_FILE);
+}
+
+static void remember_test(TestReporter *reporter, const char *name) {
+    strcat(tests_started, name);
+    strcat(tests_started, ";");
+    reporter_start(reporter, name);
+}
+
+static void remember_failure(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments) {
+    vsnprintf(failure, sizeof(failure), message, arguments);
+    failure_line = line;
+}
+
+static void remember_incomplete(TestReporter *reporter, const char *name) {
+    incomplete_tests++;
+}
+
+static void remember_metrics(TestReporter *reporter, const char *name, const TestMetrics *metrics) {
+    measured_time = metrics->wall_time;
+}
+
+static void remember_totals(TestReporter *reporter, const char *name) {
+    reporter_finish(reporter, name);
+    replayed_passes = reporter->passes;
+    replayed_failures = reporter->failures;
+    replayed_exceptions = reporter->exceptions;
+}
+
+static int replay() {
+    TestReporter *remembering = create_reporter();
+    int result;
+    remembering->start_test = &remember_test;
+    remembering->show_fail = &remember_failure;
+    remembering->show_incomplete = &remember_incomplete;
+    remembering->record_metrics = &remember_metrics;
+    remembering->finish_suite = &remember_totals;
+    close_log();
+    result = replay_event_log(EVENT_LOG_FILE, remembering);
+    restore_running_reporter();
+    return result;
+}
+
+static void run_test(const char *name, int passes, int fails, int completes) {
+    TestMetrics metrics;
+    memset(&metrics, 0, sizeof(metrics));
+    metrics.wall_time = 0.25;
+    (*log_reporter->start_test)(log_reporter, name);
+    for (; passes > 0; passes--) {
+        (*log_reporter->assert_true)(log_reporter, "file.c", 6, 1, NULL);
+    }
+    if (fails) {
+        (*log_reporter->assert_true)(log_reporter, "file.c", 7, 0, "Expected %d", 42);
+    }
+    if (completes) {
+        send_reporter_completion_notification(log_reporter);
+    }
+    (*log_reporter->record_metrics)(log_reporter, name, &metrics);
+    (*log_reporter->finish_test)(log_reporter, name);
+}
+
+static void finish_suite(const char *name) {
+    send_reporter_completion_notification(log_reporter);
+    (*log_reporter->finish_suite)(log_reporter, name);
+}
+
+Ensure replay_reports_the_same_tests_in_order() {
+    (*log_reporter->start_suite)(log_reporter, "suite", 2);
+    run_test("first", 1, 0, 1);
+    run_test("second", 1, 0, 1);
+    finish_suite("suite");
+    assert_equal(replay(), EXIT_SUCCESS);
+    assert_string_equal(tests_started, "first;second;");
+    assert_equal(replayed_passes, 2);
+}
+
+Ensure replay_reports_failures_with_their_message_and_line() {
+    (*log_reporter->start_suite)(log_reporter, "suite", 1);
+    run_test("fails", 3, 1, 1);
+    finish_suite("suite");
+    assert_equal(replay(), EXIT_FAILURE);
+    assert_string_equal(failure, "Expected 42");
+    assert_equal(failure_line, 7);
+    assert_equal(replayed_passes, 3);
+    assert_equal(replayed_failures, 1);
+}
+
+Ensure replay_reports_tests_that_did_not_complete() {
+    (*log_reporter->start_suite)(log_reporter, "suite", 1);
+    run_test("crashes", 0, 0, 0);
+    finish_suite("suite");
+    assert_equal(replay(), EXIT_FAILURE);
+    assert_equal(incomplete_tests, 1);
+    assert_equal(replayed_exceptions, 1);
+}
+
+Ensure replay_passes_on_the_recorded_metrics() {
+    (*log_reporter->start_suite)(log_reporter, "suite", 1);
+    run_test("measured", 1, 0, 1);
+    finish_suite("suite");
+    replay();
+    assert_double_equal(measured_time, 0.25);
+}
+
+Ensure replay_stops_at_the_end_of_a_log_cut_short() {
+    FILE *file;
+    char zeroes[4096];
+    (*log_reporter->start_suite)(log_reporter, "suite", 2);
+    run_test("first", 1, 0, 1);
+    close_log();
+    memset(zeroes, 0, sizeof(zeroes));
+    file = fopen(EVENT_LOG_FILE, "ab");
+    fwrite(zeroes, 1, sizeof(zeroes), file);
+    fclose(file);
+    replay();
+    assert_string_equal(tests_started, "first;");
+}
+
+Ensure replaying_what_is_not_a_log_fails() {
+    FILE *file;
+    close_log();
+    file = fopen(EVENT_LOG_FILE, "w");
+    fputs("Some stuff", file);
+    fclose(file);
+    assert_equal(replay(), EXIT_FAILURE);
+    assert_string_equal(tests_started, "");
+}
+
+TestSuite *event_log_reporter_tests() {
+    TestSuite *suite = create_test_suite();
+    setup(suite, create_log_reporter_beside_the_running_one);
+    teardown(suite, remove_event_log);
+    add_test(suite, replay_reports_the_same_tests_in_order);
+    add_test(suite, replay_reports_failures_with_their_message_and_line);
+    add_test(suite, replay_reports_tests_that_did_not_complete);
+    add_test(suite, replay_passes_on_the_recorded_metrics);
+    add_test(suite, replay_stops_at_the_end_of_a_log_cut_short);
+    add_test(suite, replaying_what_is_not_a_log_fails);
+    return suite;
+}
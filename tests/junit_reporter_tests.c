@@ -0,0 +1,139 @@
+#include <cgreen/cgreen.h>
+#include <cgreen/junit_reporter.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "reporter_fixture.h"
+
+#define JUNIT_FILE "junit_reporter_tests.xml"
+
+static TestReporter *junit;
+
+static void create_junit_reporter_beside_the_running_one() {
+    keep_running_reporter();
+    junit = beside_running_reporter(create_junit_reporter(JUNIT_FILE), 667);
+}
+
+static void remove_junit_file() {
+    destroy_reporter_beside_running_one(&junit);
+    remove(JUNIT_FILE);
+}
+
+static char *finish_and_read() {
+    FILE *file;
+    long size;
+    char *text;
+    destroy_reporter_beside_running_one(&junit);
+    file = fopen(JUNIT_FILE, "r");
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    rewind(file);
+    text = (char *)malloc(size + 1);
+    text[fread(text, 1, size, file)] = '\0';
+    fclose(file);
+    return text;
+}
+
+static void run_test(const char *name, int passes) {
+    (*junit->start_test)(junit, name);
+    if (! passes) {
+        (*junit->assert_true)(junit, "file.c", 12, 0, "Expected <%s> & \"more\"", "one");
+    }
+    send_reporter_completion_notification(junit);
+    (*junit->finish_test)(junit, name);
+}
+
+Ensure passing_test_is_an_empty_test_case_with_its_time() {
+    char *text;
+    (*junit->start_suite)(junit, "outer", 1);
+    run_test("passes", 1);
+    send_reporter_completion_notification(junit);
+    (*junit->finish_suite)(junit, "outer");
+    text = finish_and_read();
+    assert_equal(strncmp(text, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuite ", 50), 0);
+    assert_true(strstr(text, "  <testcase classname=\"outer\" name=\"passes\" time=\"") != NULL);
+    assert_true(strstr(text, "\"/>\n</testsuite>\n") != NULL);
+    free(text);
+}
+
+Ensure failure_message_is_escaped() {
+    char *text;
+    (*junit->start_suite)(junit, "outer", 1);
+    run_test("fails", 0);
+    send_reporter_completion_notification(junit);
+    (*junit->finish_suite)(junit, "outer");
+    text = finish_and_read();
+    assert_true(strstr(text,
+            "<failure type=\"assertion\" message=\"Expected &lt;one&gt; &amp; &quot;more&quot;\">"
+            "file.c:12: Expected &lt;one&gt; &amp; &quot;more&quot;</failure>\n  </testcase>\n") != NULL);
+    free(text);
+}
+
+Ensure failure_without_its_details_is_still_shown() {
+    char *text;
+    (*junit->start_suite)(junit, "outer", 1);
+    (*junit->start_test)(junit, "fails");
+    add_reporter_result(junit, 0);
+    send_reporter_completion_notification(junit);
+    (*junit->finish_test)(junit, "fails");
+    send_reporter_completion_notification(junit);
+    (*junit->finish_suite)(junit, "outer");
+    text = finish_and_read();
+    assert_true(strstr(text, "<failure type=\"assertion\" message=\"Problem\">:0: Problem</failure>") != NULL);
+    free(text);
+}
+
+Ensure test_that_does_not_complete_is_an_error() {
+    char *text;
+    (*junit->start_suite)(junit, "outer", 1);
+    (*junit->start_test)(junit, "crashes");
+    (*junit->finish_test)(junit, "crashes");
+    send_reporter_completion_notification(junit);
+    (*junit->finish_suite)(junit, "outer");
+    text = finish_and_read();
+    assert_true(strstr(text, "name=\"crashes\"") != NULL);
+    assert_true(strstr(text, "<error type=\"exception\"") != NULL);
+    free(text);
+}
+
+Ensure nested_suites_make_up_the_class_name() {
+    char *text;
+    (*junit->start_suite)(junit, "outer", 1);
+    (*junit->start_suite)(junit, "inner", 1);
+    run_test("passes", 1);
+    send_reporter_completion_notification(junit);
+    (*junit->finish_suite)(junit, "inner");
+    send_reporter_completion_notification(junit);
+    (*junit->finish_suite)(junit, "outer");
+    text = finish_and_read();
+    assert_true(strstr(text, "classname=\"outer.inner\" name=\"passes\"") != NULL);
+    free(text);
+}
+
+Ensure totals_are_written_into_the_opening_tag() {
+    char *text;
+    (*junit->start_suite)(junit, "outer", 3);
+    run_test("passes", 1);
+    run_test("fails", 0);
+    (*junit->start_test)(junit, "crashes");
+    (*junit->finish_test)(junit, "crashes");
+    send_reporter_completion_notification(junit);
+    (*junit->finish_suite)(junit, "outer");
+    text = finish_and_read();
+    assert_true(strstr(text, "<testsuite tests=\"3\" failures=\"1\" errors=\"1\" time=\"") != NULL);
+    assert_true(strstr(text, "name=\"outer\">\n") != NULL);
+    free(text);
+}
+
+TestSuite *junit_reporter_tests() {
+    TestSuite *suite = create_test_suite();
+    setup(suite, create_junit_reporter_beside_the_running_one);
+    teardown(suite, remove_junit_file);
+    add_test(suite, passing_test_is_an_empty_test_case_with_its_time);
+    add_test(suite, failure_message_is_escaped);
+    add_test(suite, failure_without_its_details_is_still_shown);
+    add_test(suite, test_that_does_not_complete_is_an_error);
+    add_test(suite, nested_suites_make_up_the_class_name);
+    add_test(suite, totals_are_written_into_the_opening_tag);
+    return suite;
+}
@@ -0,0 +1,72 @@
+#include <cgreen/cgreen.h>
+#include <cgreen/memory.h>
+#include <stdlib.h>
+#include <string.h>
+
+static MemoryPool *pool = NULL;
+
+static void create_pool() {
+    pool = create_memory_pool();
+}
+
+static void destroy_pool() {
+    free_memory_pool(pool);
+    pool = NULL;
+}
+
+Ensure allocations_do_not_overlap() {
+    char *first = (char *)memory_pool_allocate(pool, 10);
+    char *second = (char *)memory_pool_allocate(pool, 10);
+    memset(first, 'a', 10);
+    memset(second, 'b', 10);
+    assert_equal(first[9], 'a');
+    assert_equal(second[0], 'b');
+}
+
+Ensure allocations_are_aligned_for_doubles() {
+    memory_pool_allocate(pool, 1);
+    assert_equal((intptr_t)memory_pool_allocate(pool, sizeof(double)) % sizeof(double), 0);
+}
+
+Ensure allocations_larger_than_a_block_are_given_their_own() {
+    char *large = (char *)memory_pool_allocate(pool, 100000);
+    memset(large, 'a', 100000);
+    assert_equal(large[99999], 'a');
+}
+
+Ensure latest_allocation_grows_in_place() {
+    char *text = (char *)memory_pool_allocate(pool, 4);
+    strcpy(text, "abc");
+    assert_equal(memory_pool_reallocate(pool, text, 40), text);
+    assert_string_equal(text, "abc");
+}
+
+Ensure earlier_allocation_is_copied_when_it_grows() {
+    char *text = (char *)memory_pool_allocate(pool, 4);
+    char *grown;
+    strcpy(text, "abc");
+    memory_pool_allocate(pool, 4);
+    grown = (char *)memory_pool_reallocate(pool, text, 40);
+    assert_not_equal(grown, text);
+    assert_string_equal(grown, "abc");
+}
+
+Ensure emptied_pool_hands_out_the_same_memory_again() {
+    void *first = memory_pool_allocate(pool, 16);
+    memory_pool_allocate(pool, 100000);
+    empty_memory_pool(pool);
+    assert_equal(memory_pool_allocate(pool, 16), first);
+}
+
+TestSuite *memory_tests() {
+    TestSuite *suite = create_test_suite();
+    setup(suite, create_pool);
+    teardown(suite, destroy_pool);
+    add_test(suite, allocations_do_not_overlap);
+    add_test(suite, allocations_are_aligned_for_doubles);
+    add_test(suite, allocations_larger_than_a_block_are_given_their_own);
+    add_test(suite, latest_allocation_grows_in_place);
+    add_test(suite, earlier_allocation_is_copied_when_it_grows);
+    add_test(suite, emptied_pool_hands_out_the_same_memory_again);
+    return suite;
+}
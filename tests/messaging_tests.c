@@ -2,6 +2,7 @@
 #include <cgreen/messaging.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/msg.h>
 
 Ensure highly_nested_test_suite_should_still_complete() {
@@ -26,9 +27,64 @@ Ensure can_send_message() {
     assert_equal(receive_cgreen_message(messaging), 99);
 }
 
+Ensure messages_arrive_in_order_even_when_they_overflow() {
+    int messaging = start_cgreen_messaging(34);
+    int i, out_of_order = 0;
+    for (i = 0; i < 200000; i++) {
+        send_cgreen_message(messaging, i % 1000 + 1);
+    }
+    for (i = 0; i < 200000; i++) {
+        if (receive_cgreen_message(messaging) != i % 1000 + 1) {
+            out_of_order++;
+        }
+    }
+    assert_equal(out_of_order, 0);
+    assert_equal(receive_cgreen_message(messaging), 0);
+}
+
+Ensure payload_arrives_with_its_message() {
+    int messaging = start_cgreen_messaging(35);
+    void *payload;
+    size_t size;
+    send_cgreen_message(messaging, 1);
+    send_cgreen_message_with_payload(messaging, 2, "a failure", 10);
+    send_cgreen_message(messaging, 3);
+    assert_equal(receive_cgreen_message_with_payload(messaging, &payload, &size), 1);
+    assert_equal(payload, NULL);
+    assert_equal(receive_cgreen_message_with_payload(messaging, &payload, &size), 2);
+    assert_equal(size, 10);
+    assert_string_equal(payload, "a failure");
+    free(payload);
+    assert_equal(receive_cgreen_message(messaging), 3);
+}
+
+Ensure payload_larger_than_the_ring_arrives_whole() {
+    int messaging = start_cgreen_messaging(36);
+    size_t large = 300000 * sizeof(int);
+    char *sent = (char *)malloc(large);
+    void *payload;
+    size_t size;
+    memset(sent, 'x', large - 1);
+    sent[large - 1] = '\0';
+    send_cgreen_message(messaging, 1);
+    send_cgreen_message_with_payload(messaging, 2, sent, large);
+    send_cgreen_message(messaging, 3);
+    assert_equal(receive_cgreen_message(messaging), 1);
+    assert_equal(receive_cgreen_message_with_payload(messaging, &payload, &size), 2);
+    assert_equal(size, large);
+    assert_equal(memcmp(payload, sent, large), 0);
+    free(payload);
+    free(sent);
+    assert_equal(receive_cgreen_message(messaging), 3);
+    assert_equal(receive_cgreen_message(messaging), 0);
+}
+
 TestSuite *messaging_tests() {
     TestSuite *suite = create_test_suite();
     add_suite(suite, highly_nested_test_suite());
     add_test(suite, can_send_message);
+    add_test(suite, messages_arrive_in_order_even_when_they_overflow);
+    add_test(suite, payload_arrives_with_its_message);
+    add_test(suite, payload_larger_than_the_ring_arrives_whole);
     return suite;
 }
@@ -1,11 +1,20 @@
 #include <cgreen/cgreen.h>
 #include <cgreen/mocks.h>
 #include <stdlib.h>
+#if !defined WIN32 && !defined WINCE
+#include <pthread.h>
+#endif
 
 static int integer_out() {
     return (int)mock();
 }
 
+static char *string_out();
+
+static int two_parameters_out(int first, int second) {
+    return (int)mock(first, second);
+}
+
 Ensure no_errors_thrown_when_no_presets() {
     integer_out();
 }
@@ -51,6 +60,61 @@ Ensure stub_uses_the_always_value_once_hit() {
     assert_equal(integer_out(), 3);
 }
 
+Ensure stubs_are_found_by_name_not_by_address() {
+    char name[] = "integer_out";
+    will_return_(name, 7);
+    always_return(integer_out, 8);
+    assert_equal(integer_out(), 7);
+    assert_equal(integer_out(), 8);
+}
+
+Ensure parameter_names_are_parsed_again_when_their_text_changes() {
+    char parameters[] = "a";
+    int a = 0, b = 0;
+    always_expect_("set_through", __FILE__, __LINE__, set(a, 1), set(b, 2), (Constraint *)0);
+    mock_("set_through", parameters, (intptr_t)&a);
+    parameters[0] = 'b';
+    mock_("set_through", parameters, (intptr_t)&b);
+    assert_equal(a, 1);
+    assert_equal(b, 2);
+}
+
+Ensure constraints_follow_their_parameter_to_a_new_position() {
+    int x = 0, y = 0, z = 0;
+    always_expect_("moving_parameter", __FILE__, __LINE__, set(b, 5), (Constraint *)0);
+    mock_("moving_parameter", "a, b", (intptr_t)&x, (intptr_t)&y);
+    mock_("moving_parameter", "b", (intptr_t)&z);
+    assert_equal(x, 0);
+    assert_equal(y, 5);
+    assert_equal(z, 5);
+}
+
+Ensure calls_are_counted_in_the_journal() {
+    integer_out();
+    integer_out();
+    assert_equal(mock_call_count(integer_out), 2);
+    assert_equal(mock_call_count(string_out), 0);
+}
+
+Ensure journal_keeps_the_arguments_of_each_call() {
+    two_parameters_out(5, 6);
+    two_parameters_out(7, 8);
+    assert_equal(nth_mock_call(two_parameters_out, 2)->argument_count, 2);
+    assert_equal(nth_mock_call(two_parameters_out, 2)->arguments[0], 7);
+    assert_equal(nth_mock_call(two_parameters_out, 1)->arguments[1], 6);
+    assert_equal(nth_mock_call(two_parameters_out, 3), NULL);
+}
+
+Ensure journal_knows_the_order_of_calls() {
+    two_parameters_out(1, 2);
+    integer_out();
+    two_parameters_out(3, 4);
+    assert_true(mock_calls_in_order(two_parameters_out, integer_out));
+    assert_true(mock_calls_in_order(integer_out, two_parameters_out));
+    assert_false(mock_calls_in_order(integer_out, integer_out));
+    assert_false(mock_calls_in_order(string_out));
+}
+
 static char *string_out() {
     return (char *)mock();
 }
@@ -181,6 +245,67 @@ Ensure can_declare_function_never_called() {
     expect_never(sample_mock);
 }
 
+#if !defined WIN32 && !defined WINCE
+#define CALLING_THREADS 4
+#define CALLS_PER_THREAD 500
+
+static void *sum_of_integers_out(void *unused) {
+    intptr_t sum = 0;
+    int i;
+    for (i = 0; i < CALLS_PER_THREAD; i++) {
+        sum += integer_out();
+    }
+    return (void *)sum;
+}
+
+static void *many_integers_in(void *unused) {
+    int i;
+    for (i = 0; i < CALLS_PER_THREAD; i++) {
+        integer_in(7);
+    }
+    return NULL;
+}
+
+Ensure threads_take_each_stubbed_result_once() {
+    pthread_t threads[CALLING_THREADS];
+    intptr_t total = 0;
+    int calls = CALLING_THREADS * CALLS_PER_THREAD;
+    int i;
+    for (i = 1; i <= calls; i++) {
+        will_return(integer_out, i);
+    }
+    for (i = 0; i < CALLING_THREADS; i++) {
+        pthread_create(&threads[i], NULL, &sum_of_integers_out, NULL);
+    }
+    for (i = 0; i < CALLING_THREADS; i++) {
+        void *sum;
+        pthread_join(threads[i], &sum);
+        total += (intptr_t)sum;
+    }
+    assert_equal(total, (intptr_t)calls * (calls + 1) / 2);
+    assert_equal(mock_call_count(integer_out), calls);
+    for (i = 1; i < calls; i++) {
+        if (nth_mock_call(integer_out, i)->sequence >= nth_mock_call(integer_out, i + 1)->sequence) {
+            break;
+        }
+    }
+    assert_equal(i, calls);
+}
+
+Ensure constraints_are_checked_in_every_calling_thread() {
+    pthread_t threads[CALLING_THREADS];
+    int i;
+    always_expect(integer_in, want(i, 7));
+    for (i = 0; i < CALLING_THREADS; i++) {
+        pthread_create(&threads[i], NULL, &many_integers_in, NULL);
+    }
+    for (i = 0; i < CALLING_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    assert_equal(mock_call_count(integer_in), CALLING_THREADS * CALLS_PER_THREAD);
+}
+#endif
+
 TestSuite *mock_tests() {
     TestSuite *suite = create_test_suite();
     add_test(suite, no_errors_thrown_when_no_presets);
@@ -190,6 +315,12 @@ TestSuite *mock_tests() {
     add_test(suite, set_stub_just_to_be_cleared);
     add_test(suite, confirm_stub_is_reset_between_tests);
     add_test(suite, stub_uses_the_always_value_once_hit);
+    add_test(suite, stubs_are_found_by_name_not_by_address);
+    add_test(suite, parameter_names_are_parsed_again_when_their_text_changes);
+    add_test(suite, constraints_follow_their_parameter_to_a_new_position);
+    add_test(suite, calls_are_counted_in_the_journal);
+    add_test(suite, journal_keeps_the_arguments_of_each_call);
+    add_test(suite, journal_knows_the_order_of_calls);
     add_test(suite, can_stub_a_string_return);
     add_test(suite, can_stub_a_string_sequence);
     add_test(suite, expecting_once_with_any_parameters);
@@ -208,5 +339,9 @@ TestSuite *mock_tests() {
     add_test(suite, can_mock_full_sequence);
     add_test(suite, can_always_mock_full_function_call);
     add_test(suite, can_declare_function_never_called);
+#if !defined WIN32 && !defined WINCE
+    add_test(suite, threads_take_each_stubbed_result_once);
+    add_test(suite, constraints_are_checked_in_every_calling_thread);
+#endif
     return suite;
 }
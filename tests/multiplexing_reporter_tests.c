@@ -0,0 +1,162 @@
+#include <cgreen/cgreen.h>
+#include <cgreen/multiplexing_reporter.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "reporter_fixture.h"
+
+typedef struct {
+    char tests[100];
+    char failure[100];
+    int incomplete_tests;
+    double measured_time;
+} Remembered;
+
+static TestReporter *multiplexer;
+static TestReporter *children[2];
+static Remembered remembered[2];
+
+static void remember_test(TestReporter *reporter, const char *name) {
+    Remembered *memo = (Remembered *)reporter->memo;
+    strcat(memo->tests, name);
+    strcat(memo->tests, ";");
+    reporter_start(reporter, name);
+}
+
+static void remember_failure(TestReporter *reporter, const char *file, int line, const char *message, va_list arguments) {
+    vsnprintf(((Remembered *)reporter->memo)->failure, sizeof(remembered[0].failure), message, arguments);
+}
+
+static void remember_incomplete(TestReporter *reporter, const char *name) {
+    ((Remembered *)reporter->memo)->incomplete_tests++;
+}
+
+static void remember_metrics(TestReporter *reporter, const char *name, const TestMetrics *metrics) {
+    ((Remembered *)reporter->memo)->measured_time = metrics->wall_time;
+}
+
+static void forget(TestReporter *reporter) {
+    reporter->memo = NULL;
+    destroy_reporter(reporter);
+}
+
+static TestReporter *create_remembering_reporter(Remembered *memo) {
+    TestReporter *reporter = create_reporter();
+    memset(memo, 0, sizeof(Remembered));
+    reporter->destroy = &forget;
+    reporter->start_test = &remember_test;
+    reporter->show_fail = &remember_failure;
+    reporter->show_incomplete = &remember_incomplete;
+    reporter->record_metrics = &remember_metrics;
+    reporter->memo = memo;
+    return reporter;
+}
+
+static void create_multiplexer_beside_the_running_one() {
+    keep_running_reporter();
+    children[0] = create_remembering_reporter(&remembered[0]);
+    children[1] = create_remembering_reporter(&remembered[1]);
+    multiplexer = beside_running_reporter(create_multiplexing_reporter(children, 2), 670);
+}
+
+static void destroy_multiplexer() {
+    destroy_reporter_beside_running_one(&multiplexer);
+}
+
+static void nest_the_second_reporter() {
+    TestReporter *nested;
+    destroy_multiplexer();
+    children[0] = create_remembering_reporter(&remembered[0]);
+    nested = create_remembering_reporter(&remembered[1]);
+    children[1] = create_multiplexing_reporter(&nested, 1);
+    multiplexer = beside_running_reporter(create_multiplexing_reporter(children, 2), 670);
+}
+
+static void run_test(const char *name, int passes, int fails, int completes) {
+    TestMetrics metrics;
+    memset(&metrics, 0, sizeof(metrics));
+    metrics.wall_time = 0.5;
+    (*multiplexer->start_test)(multiplexer, name);
+    for (; passes > 0; passes--) {
+        (*multiplexer->assert_true)(multiplexer, "file.c", 6, 1, NULL);
+    }
+    if (fails) {
+        (*multiplexer->assert_true)(multiplexer, "file.c", 7, 0, "Expected %d", 42);
+    }
+    if (completes) {
+        send_reporter_completion_notification(multiplexer);
+    }
+    (*multiplexer->record_metrics)(multiplexer, name, &metrics);
+    (*multiplexer->finish_test)(multiplexer, name);
+}
+
+static void run_suite_of(const char *name, int passes, int fails, int completes) {
+    (*multiplexer->start_suite)(multiplexer, "suite", 1);
+    run_test(name, passes, fails, completes);
+    send_reporter_completion_notification(multiplexer);
+    (*multiplexer->finish_suite)(multiplexer, "suite");
+}
+
+Ensure every_reporter_sees_every_test() {
+    (*multiplexer->start_suite)(multiplexer, "suite", 2);
+    run_test("first", 1, 0, 1);
+    run_test("second", 1, 0, 1);
+    send_reporter_completion_notification(multiplexer);
+    (*multiplexer->finish_suite)(multiplexer, "suite");
+    assert_string_equal(remembered[0].tests, "first;second;");
+    assert_string_equal(remembered[1].tests, "first;second;");
+}
+
+Ensure every_reporter_counts_the_passes_read_once() {
+    run_suite_of("passes", 3, 0, 1);
+    assert_equal(multiplexer->passes, 3);
+    assert_equal(children[0]->passes, 3);
+    assert_equal(children[1]->passes, 3);
+}
+
+Ensure every_reporter_is_shown_the_failures() {
+    run_suite_of("fails", 1, 1, 1);
+    assert_string_equal(remembered[0].failure, "Expected 42");
+    assert_string_equal(remembered[1].failure, "Expected 42");
+    assert_equal(multiplexer->failures, 1);
+    assert_equal(children[0]->failures, 1);
+    assert_equal(children[1]->failures, 1);
+}
+
+Ensure every_reporter_is_told_of_tests_that_did_not_complete() {
+    run_suite_of("crashes", 0, 0, 0);
+    assert_equal(remembered[0].incomplete_tests, 1);
+    assert_equal(remembered[1].incomplete_tests, 1);
+    assert_equal(multiplexer->exceptions, 1);
+    assert_equal(children[1]->exceptions, 1);
+}
+
+Ensure every_reporter_gets_the_metrics() {
+    run_suite_of("measured", 1, 0, 1);
+    assert_double_equal(remembered[0].measured_time, 0.5);
+    assert_double_equal(remembered[1].measured_time, 0.5);
+}
+
+Ensure nested_multiplexer_passes_on_the_results_it_was_given() {
+    nest_the_second_reporter();
+    run_suite_of("fails", 2, 1, 1);
+    assert_string_equal(remembered[1].failure, "Expected 42");
+    assert_equal(remembered[1].incomplete_tests, 0);
+    assert_equal(children[1]->passes, 2);
+    assert_equal(children[1]->failures, 1);
+    assert_equal(children[1]->exceptions, 0);
+    assert_equal(multiplexer->exceptions, 0);
+}
+
+TestSuite *multiplexing_reporter_tests() {
+    TestSuite *suite = create_test_suite();
+    setup(suite, create_multiplexer_beside_the_running_one);
+    teardown(suite, destroy_multiplexer);
+    add_test(suite, every_reporter_sees_every_test);
+    add_test(suite, every_reporter_counts_the_passes_read_once);
+    add_test(suite, every_reporter_is_shown_the_failures);
+    add_test(suite, every_reporter_is_told_of_tests_that_did_not_complete);
+    add_test(suite, every_reporter_gets_the_metrics);
+    add_test(suite, nested_multiplexer_passes_on_the_results_it_was_given);
+    return suite;
+}
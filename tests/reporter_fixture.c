@@ -0,0 +1,29 @@
+#include "reporter_fixture.h"
+#include <cgreen/messaging.h>
+#include <stdlib.h>
+
+static TestReporter *running;
+
+void keep_running_reporter() {
+    running = get_test_reporter();
+}
+
+void restore_running_reporter() {
+    set_test_reporter(running);
+}
+
+TestReporter *beside_running_reporter(TestReporter *reporter, int messaging_tag) {
+    reporter->ipc = start_cgreen_messaging(messaging_tag);
+    restore_running_reporter();
+    return reporter;
+}
+
+void destroy_reporter_beside_running_one(TestReporter **reporter) {
+    if (*reporter != NULL) {
+        (*(*reporter)->destroy)(*reporter);
+        *reporter = NULL;
+    }
+    restore_running_reporter();
+}
+
+/* vim: set ts=4 sw=4 et cindent: */
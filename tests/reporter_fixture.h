@@ -0,0 +1,14 @@
+#ifndef REPORTER_FIXTURE_HEADER
+#define REPORTER_FIXTURE_HEADER
+
+#include <cgreen/reporter.h>
+
+/* Creating a reporter makes it the one the assertions go to, so the
+   reporter running these tests is kept first and put back afterwards.
+   The reporter under test gets messaging of its own. */
+void keep_running_reporter();
+void restore_running_reporter();
+TestReporter *beside_running_reporter(TestReporter *reporter, int messaging_tag);
+void destroy_reporter_beside_running_one(TestReporter **reporter);
+
+#endif
@@ -0,0 +1,118 @@
+#include <cgreen/cgreen.h>
+#include <cgreen/reporter_output.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static FILE *file;
+static ReporterOutput *output;
+
+static void open_output() {
+    file = tmpfile();
+    output = create_reporter_output(fileno(file));
+}
+
+static void close_output() {
+    if (output != NULL) {
+        destroy_reporter_output(output);
+    }
+    fclose(file);
+}
+
+static char *written() {
+    long size;
+    char *text;
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    rewind(file);
+    text = (char *)malloc(size + 1);
+    text[fread(text, 1, size, file)] = '\0';
+    return text;
+}
+
+Ensure nothing_is_written_until_flushed() {
+    char *text;
+    reporter_output_printf(output, "%s %d", "Hello", 42);
+    text = written();
+    assert_string_equal(text, "");
+    free(text);
+    flush_reporter_output(output);
+    text = written();
+    assert_string_equal(text, "Hello 42");
+    free(text);
+}
+
+Ensure destroying_the_output_writes_what_is_queued() {
+    char *text;
+    reporter_output_printf(output, "Goodbye");
+    destroy_reporter_output(output);
+    output = NULL;
+    text = written();
+    assert_string_equal(text, "Goodbye");
+    free(text);
+}
+
+Ensure text_wrapping_round_the_ring_keeps_its_order() {
+    char line[100];
+    char *text;
+    int i;
+    for (i = 0; i < 5000; i++) {
+        reporter_output_printf(output, "Line %d\n", i);
+    }
+    flush_reporter_output(output);
+    text = written();
+    for (i = 0; i < 5000; i += 999) {
+        sprintf(line, "\nLine %d\n", i);
+        assert_true(i == 0 || strstr(text, line) != NULL);
+    }
+    assert_equal(strncmp(text, "Line 0\nLine 1\n", 14), 0);
+    assert_string_equal(text + strlen(text) - 10, "Line 4999\n");
+    free(text);
+}
+
+Ensure text_larger_than_the_ring_is_written_after_what_is_queued() {
+    size_t size = 200000;
+    char *large = (char *)malloc(size + 1);
+    char *text;
+    memset(large, 'x', size);
+    large[size] = '\0';
+    reporter_output_printf(output, "Before ");
+    reporter_output_printf(output, "%s", large);
+    reporter_output_printf(output, " after");
+    flush_reporter_output(output);
+    text = written();
+    assert_equal(strlen(text), size + 13);
+    assert_equal(strncmp(text, "Before xxx", 10), 0);
+    assert_string_equal(text + size + 7, " after");
+    free(text);
+    free(large);
+}
+
+Ensure writer_thread_has_written_everything_once_flushed() {
+    char *text;
+    int i;
+    write_reporter_output_in_background(output);
+    for (i = 0; i < 20000; i++) {
+        reporter_output_printf(output, "%d,", i % 10);
+        reporter_output_event_done(output);
+    }
+    flush_reporter_output(output);
+    text = written();
+    assert_equal(strlen(text), 40000);
+    assert_equal(strncmp(text, "0,1,2,3,4,5,6,7,8,9,0,1,", 24), 0);
+    assert_string_equal(text + 39980, "0,1,2,3,4,5,6,7,8,9,");
+    free(text);
+}
+
+TestSuite *reporter_output_tests() {
+    TestSuite *suite = create_test_suite();
+    setup(suite, open_output);
+    teardown(suite, close_output);
+    add_test(suite, nothing_is_written_until_flushed);
+    add_test(suite, destroying_the_output_writes_what_is_queued);
+    add_test(suite, text_wrapping_round_the_ring_keeps_its_order);
+    add_test(suite, text_larger_than_the_ring_is_written_after_what_is_queued);
+    add_test(suite, writer_thread_has_written_everything_once_flushed);
+    return suite;
+}
@@ -1,8 +1,13 @@
 #include <cgreen/cgreen.h>
 #include <cgreen/unit.h>
+#include <cgreen/reporter_output.h>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 Ensure count_tests_return_zero_for_empty_suite() {
 	TestSuite *suite = create_test_suite();
@@ -30,10 +35,208 @@ Ensure count_tests_return_four_for_four_nested_suite_with_one_testcase_each() {
 	assert_equal(count_tests(suite1), 4);
 }
 
+static int tests_run_after_crash = 0;
+
+static void crash() {
+	*(volatile int *)NULL = 0;
+}
+
+static void count_test_run_after_crash() {
+	tests_run_after_crash++;
+}
+
+Ensure crash_in_process_is_reported_and_the_run_carries_on() {
+	TestReporter *reporter = get_test_reporter();
+	TestSuite *suite = create_test_suite();
+	int result;
+	add_test(suite, crash);
+	add_test(suite, count_test_run_after_crash);
+	tests_run_after_crash = 0;
+	result = run_test_suite_in_process(suite, create_reporter());
+	set_test_reporter(reporter);
+	assert_equal(result, EXIT_FAILURE);
+	assert_equal(tests_run_after_crash, 1);
+}
+
+static int tests_measured = 0;
+
+static void count_measured_test(TestReporter *reporter, const char *name, const TestMetrics *metrics) {
+	if (metrics->wall_time >= 0.0 && metrics->user_time >= 0.0) {
+		tests_measured++;
+	}
+}
+
+Ensure every_test_run_has_its_metrics_recorded() {
+	TestReporter *reporter = get_test_reporter();
+	TestReporter *measuring = create_reporter();
+	TestSuite *suite = create_test_suite();
+	add_test(suite, count_test_run_after_crash);
+	add_test(suite, count_test_run_after_crash);
+	measuring->record_metrics = &count_measured_test;
+	tests_measured = 0;
+	run_test_suite_in_process(suite, measuring);
+	set_test_reporter(reporter);
+	assert_equal(tests_measured, 2);
+}
+
+static int outer_tests_run = 0;
+static int inner_tests_run = 0;
+static int selection_result = EXIT_SUCCESS;
+
+static void outer_test() {
+	outer_tests_run++;
+}
+
+static void inner_test() {
+	inner_tests_run++;
+}
+
+static int run_selection(char *selection) {
+	TestReporter *reporter = get_test_reporter();
+	TestSuite *outer = create_named_test_suite("outer");
+	TestSuite *inner = create_named_test_suite("inner");
+	int quiet = open("/dev/null", O_WRONLY);
+	int saved;
+	add_test_(outer, "same_name", &outer_test);
+	add_test_(inner, "same_name", &inner_test);
+	add_test_(inner, "other_name", &inner_test);
+	add_suite(outer, inner);
+	outer_tests_run = inner_tests_run = 0;
+	flush_standard_reporter_output();
+	fflush(stdout);
+	saved = dup(STDOUT_FILENO);
+	dup2(quiet, STDOUT_FILENO);
+	selection_result = run_selected_tests(outer, &selection, 1, create_reporter());
+	fflush(stdout);
+	dup2(saved, STDOUT_FILENO);
+	close(saved);
+	close(quiet);
+	set_test_reporter(reporter);
+	return outer_tests_run * 10 + inner_tests_run;
+}
+
+Ensure bare_name_selects_every_test_of_that_name() {
+	assert_equal(run_selection("same_name"), 11);
+}
+
+Ensure path_selects_one_test() {
+	assert_equal(run_selection("inner/same_name"), 1);
+}
+
+Ensure trailing_slash_selects_a_whole_suite() {
+	assert_equal(run_selection("inner/"), 2);
+}
+
+Ensure wildcards_select_by_path_or_name() {
+	assert_equal(run_selection("*_name"), 12);
+	assert_equal(run_selection("inn?r/*"), 2);
+	assert_equal(run_selection("missing*"), 0);
+}
+
+Ensure path_may_start_with_the_suite_being_run() {
+	assert_equal(run_selection("outer/inner/same_name"), 1);
+	assert_equal(run_selection("outer/"), 12);
+	assert_equal(run_selection("outer/inn?r/*"), 2);
+}
+
+Ensure selection_that_matches_nothing_fails_the_run() {
+	assert_equal(run_selection("missing"), 0);
+	assert_equal(selection_result, EXIT_FAILURE);
+	assert_equal(run_selection("outer/missing"), 0);
+	assert_equal(selection_result, EXIT_FAILURE);
+	run_selection("inner/same_name");
+	assert_equal(selection_result, EXIT_SUCCESS);
+}
+
+#define NESTING_LOG "unit_tests_nesting.log"
+
+static void log_nesting(const char *event) {
+	int log = open(NESTING_LOG, O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if (log >= 0) {
+		if (write(log, event, strlen(event)) < 0) {
+			/* The order is checked afterwards */
+		}
+		close(log);
+	}
+}
+
+static int count_events(const char *events, const char *event) {
+	int found = 0;
+	while ((events = strstr(events, event)) != NULL) {
+		found++;
+		events++;
+	}
+	return found;
+}
+
+static void outer_setup() {
+	log_nesting("outer setup;");
+}
+
+static void outer_teardown() {
+	log_nesting("outer teardown;");
+}
+
+static void inner_setup() {
+	log_nesting("inner setup;");
+}
+
+static void inner_teardown() {
+	log_nesting("inner teardown;");
+}
+
+static void first_nested_test() {
+	log_nesting("first;");
+}
+
+static void second_nested_test() {
+	log_nesting("second;");
+}
+
+Ensure enclosing_suites_are_set_up_once_around_their_nested_suites() {
+	TestReporter *reporter = get_test_reporter();
+	TestSuite *outer = create_named_test_suite("outer");
+	TestSuite *inner = create_named_test_suite("inner");
+	char events[200];
+	FILE *log;
+	size_t size;
+	setup(outer, outer_setup);
+	teardown(outer, outer_teardown);
+	setup(inner, inner_setup);
+	teardown(inner, inner_teardown);
+	add_test_(inner, "first", &first_nested_test);
+	add_test_(inner, "second", &second_nested_test);
+	add_suite(outer, inner);
+	remove(NESTING_LOG);
+	run_test_suite_parallel(outer, create_reporter(), 2);
+	set_test_reporter(reporter);
+	log = fopen(NESTING_LOG, "r");
+	assert_not_equal(log, NULL);
+	size = fread(events, 1, sizeof(events) - 1, log);
+	events[size] = '\0';
+	fclose(log);
+	remove(NESTING_LOG);
+	assert_equal(strncmp(events, "outer setup;", 12), 0);
+	assert_string_equal(events + size - 15, "outer teardown;");
+	assert_equal(count_events(events, "outer setup;"), 1);
+	assert_equal(count_events(events, "outer teardown;"), 1);
+	assert_equal(count_events(events, "inner setup;"), 2);
+	assert_equal(count_events(events, "inner teardown;"), 2);
+}
+
 TestSuite *unit_tests() {
 	TestSuite *suite = create_test_suite();
 	add_test(suite, count_tests_return_zero_for_empty_suite);
 	add_test(suite, count_tests_return_one_for_suite_with_one_testcase);
 	add_test(suite, count_tests_return_four_for_four_nested_suite_with_one_testcase_each);
+	add_test(suite, crash_in_process_is_reported_and_the_run_carries_on);
+	add_test(suite, every_test_run_has_its_metrics_recorded);
+	add_test(suite, bare_name_selects_every_test_of_that_name);
+	add_test(suite, path_selects_one_test);
+	add_test(suite, trailing_slash_selects_a_whole_suite);
+	add_test(suite, wildcards_select_by_path_or_name);
+	add_test(suite, path_may_start_with_the_suite_being_run);
+	add_test(suite, selection_that_matches_nothing_fails_the_run);
+	add_test(suite, enclosing_suites_are_set_up_once_around_their_nested_suites);
 	return suite;
 }
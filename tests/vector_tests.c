@@ -4,9 +4,11 @@
 
 static CgreenVector *vector;
 static char a = 'a', b = 'b', c = 'c';
+static int times_called = 0;
 
 static void set_up_vector() {
     vector = create_cgreen_vector(NULL);
+    times_called = 0;
 }
 
 static void tear_down_vector() {
@@ -73,7 +75,37 @@ Ensure can_extract_middle_item() {
     assert_equal(*(char *)cgreen_vector_get(vector, 1), 'c');
 }
 
-static int times_called = 0;
+Ensure removing_past_either_end_gives_null() {
+    cgreen_vector_add(vector, &a);
+    assert_equal(cgreen_vector_remove(vector, 1), NULL);
+    assert_equal(cgreen_vector_remove(vector, -1), NULL);
+    assert_equal(cgreen_vector_size(vector), 1);
+}
+
+Ensure items_keep_their_order_when_used_as_a_queue() {
+    static int numbers[100];
+    int i, in_order = 1;
+    for (i = 0; i < 100; i++) {
+        numbers[i] = i;
+    }
+    for (i = 0; i < 10; i++) {
+        cgreen_vector_add(vector, &numbers[i]);
+    }
+    for (i = 10; i < 100; i++) {
+        cgreen_vector_add(vector, &numbers[i]);
+        if (*(int *)cgreen_vector_remove(vector, 0) != i - 10) {
+            in_order = 0;
+        }
+        if (i % 3 == 0) {
+            cgreen_vector_add(vector, &numbers[0]);
+            cgreen_vector_remove(vector, cgreen_vector_size(vector) - 1);
+        }
+    }
+    assert_true(in_order);
+    assert_equal(cgreen_vector_size(vector), 10);
+    assert_equal(*(int *)cgreen_vector_get(vector, 9), 99);
+}
+
 static void sample_destructor(void *item) {
     times_called++;
 }
@@ -117,6 +149,8 @@ TestSuite *vector_tests() {
     add_test(suite, can_extract_head_item);
     add_test(suite, can_extract_tail_item);
     add_test(suite, can_extract_middle_item);
+    add_test(suite, removing_past_either_end_gives_null);
+    add_test(suite, items_keep_their_order_when_used_as_a_queue);
     add_test(suite, destructor_is_called_on_single_item);
     add_test(suite, destructor_is_not_called_on_empty_vector);
     add_test(suite, destructor_is_called_three_times_on_three_item_vector);